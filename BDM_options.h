@@ -34,6 +34,10 @@ typedef enum  {
 //===============================
 #define HCS_SBDFR_BDFR (0x01) //!< HCS08 SBDFR BDFR mask
 
+#define HCS_BDCSCR_ENBDM   (0x80) //!< HCS08 BDCSCR BDM enabled
+#define HCS_BDCSCR_BDMACT  (0x40) //!< HCS08 BDCSCR target is in active background mode
+#define HCS_BDCSCR_CLKSW   (0x08) //!< HCS08 BDCSCR BDC clocked by the bus clock (else alternate clock)
+
 
 //! Target interface options
 typedef struct {
@@ -156,7 +160,7 @@ typedef struct {
    TargetVddState_t    power:8;        //!< Target Vdd state
    TargetVppSelect_t   flashState:8;   //!< State of RS08 Flash programming,  see \ref FlashState_t
    uint16_t            sync_length;    //!< Length of the target SYNC pulse in 60MHz ticks
-   uint16_t            wait150_cnt;    //!< Time for 150 BDM cycles in bus cycles of the MCU divided by N
-   uint16_t            wait64_cnt;     //!< Time for 64 BDM cycles in bus cycles of the MCU divided by N
+   uint16_t            wait150_cnt;    //!< Time for 150 BDM cycles in system clock cycles of the probe
+   uint16_t            wait64_cnt;     //!< Time for 64 BDM cycles in system clock cycles of the probe
    uint8_t             bdmpprValue;    //!< BDMPPR value for HCS12
 } CableStatus_t;
\ No newline at end of file
@@ -1,29 +1,44 @@
 #include "bdm.h"
 
 #include "hardware/pio.h"
+#include "hardware/clocks.h"
 #include "pico/stdlib.h"
+#include <string.h>
 
 #include "pio_functions.h"
 #include "config.h"
 #include "BDM_options.h"
 
-// Select state machine
-static bool is_sm_init = false;
-// BDM data program has been saved into PIO instruction memory?
-static bool is_bdm_data_init = false;
+// PIO programs and state machines have been set up?
+static bool is_pio_init = false;
 // The target frequency has been ackowledged?
 static bool is_freq_known = false; 
-// Frequency of the PIO
-static float pio_freq = PIO_FREQ;
-// 16-bit Sync value in 1MHz ticks
-static uint16_t ticks = 0;  
-// Offset of the PIO instruction memory
+// Target ACK pulses are used instead of the fixed delay?
+static bool is_ack_enabled = false;
+// Length of the target SYNC response in system clock cycles (averaged)
+static uint32_t sync_cycles = 0;
+// First error of a burst since the last bdm_take_error()
+static uint8_t burst_error = BDM_RC_OK;
+// Offset of bdm-data.pio in the PIO instruction memory
 static uint pio_offset = 0;
-// Selected PIO
+// Offset of bdm-sync.pio in the PIO instruction memory
+static uint sync_offset = 0;
+// PIO running bdm-data.pio
 static PIO pio = pio0;
-// Claimed PIO state machine
-// Get first free state machine in PIO 0
+// PIO running bdm-sync.pio. Both programs don't fit in a single instruction memory
+static PIO sync_pio = pio1;
+// Claimed PIO state machines
 static uint sm;
+static uint sync_sm;
+
+// Frames of the current burst (header and data word for each frame, see bdm-data.pio)
+static uint frame_buffer[2*MAX_BDM_FRAMES];
+// Number of frames queued in frame_buffer
+static uint frame_count = 0;
+// More than MAX_BDM_FRAMES frames have been queued, the burst is refused
+static bool is_frame_overflow = false;
+// Data received by a burst, one byte per frame
+static uint8_t rx_buffer[MAX_BDM_FRAMES];
 
 // Data buffer
 //! @note : Format
@@ -49,118 +64,445 @@ uint _make_data()
     return data;
 }
 
-//! Execute BDM command
-//!
-//! @param
-//!    data: (max 32 bit) -> BDM COMMAND CODE | PARAMETERS (OPT) 
-//! @param
-//!    tx_bit_count: number of bit to transmit (command code included)
-//! @param
-//!    rx_bit_count: number of bit to receive (can be zero)
+//! Load bdm-data.pio and bdm-sync.pio, claim their state machines and the DMA channels
 //!
-//! @return
-//!     Received data
+//! @note
+//!     Both programs stay resident, so a SYNC doesn't need to reload bdm-data.pio.
+//!     Must be called after the system clock has been set.
 //!
-uint bdm_command_exec(void)
+void bdm_pio_init(void)
 {
-    if(!is_sm_init)
+    if(is_pio_init)
     {
-        // Get first free state machine in PIO 0
-        uint sm = pio_claim_unused_sm(pio, true);
-
-        is_sm_init = true;
+        return;
     }
 
+    sm = pio_claim_unused_sm(pio, true);
+    sync_sm = pio_claim_unused_sm(sync_pio, true);
+
+    bdm_dma_init();
+
+    // bdm-data.pio is loaded last, so it owns the pin
+    sync_offset = sync_init(sync_pio, sync_sm);
+    pio_offset = bdm_init(pio, sm, PIO_FREQ);
+
+    is_pio_init = true;
+}
+
+// Make sure the target speed is known
+static void _bdm_prepare(void)
+{
+    bdm_pio_init();
+
     // Check if frequency is known
     if (!is_freq_known)
     {
         bdm_cmd_sync();
     }
+}
+
+// Commands without delay between tx and rx
+static bool _is_no_delay(uint8_t command)
+{
+    switch (command)
+    {
+        case READ_STATUS:
+        case WRITE_CONTROL:
+        case READ_BKPT:
+        case WRITE_BKPT:
+            return true;
+        default:
+            return false;
+    }
+}
 
-    // Check if the program is in the pio memory
-    if(!is_bdm_data_init)
+//! Queue a frame in frame_buffer
+//!
+//! @param data     : BDM COMMAND CODE | PARAMETERS (OPT), right aligned
+//! @param tx_bytes : number of bytes to transmit (command code included)
+//! @param rx_bytes : number of bytes to receive (can be zero)
+//!
+//! @note
+//!     Frames beyond MAX_BDM_FRAMES are dropped and the burst fails with BDM_RC_ILLEGAL_PARAMS.
+//!
+static void _queue_frame(uint data, uint8_t tx_bytes, uint8_t rx_bytes)
+{
+    if (frame_count >= MAX_BDM_FRAMES)
     {
-        // Overwrite pio instruction memory with "bdm-data.pio" program and return offset
-        pio_offset = bdm_init(pio, sm, pio_freq);
+        is_frame_overflow = true;
+        return;
+    }
+
+    uint *frame = frame_buffer + 2*frame_count;
+    uint8_t command = (uint8_t)(data >> ((tx_bytes-1)*BYTE));
+
+    frame[0] = bdm_frame_header(tx_bytes*BYTE, rx_bytes*BYTE, _is_no_delay(command), is_ack_enabled ? ACK_TIMEOUT : 0);
+    frame[1] = data << (REG_WIDTH - tx_bytes*BYTE);
 
-        is_bdm_data_init = true;
+    frame_count++;
+}
+
+// Keep the first error until bdm_take_error()
+static uint8_t _burst_error(uint8_t error)
+{
+    if (burst_error == BDM_RC_OK)
+    {
+        burst_error = error;
     }
 
-    // Make data based on bytes in data_buffer
-    uint data = _make_data();
-    uint8_t tx_bit_count = data_buffer[TX_BYTE_COUNT]*BYTE;
-    uint8_t rx_bit_count = data_buffer[RX_BYTE_COUNT]*BYTE;
+    return error;
+}
 
-    do_bdm_command(pio, sm, data, tx_bit_count, rx_bit_count, pio_offset);
+//! Longest time of a burst at the current speed
+//!
+//! @param count : number of frames queued in frame_buffer
+//!
+//! @return time in us, see bdm_burst_max_cycles()
+//!
+static uint32_t _burst_timeout_us(uint count)
+{
+    uint32_t sys_hz = clock_get_hz(clk_sys);
 
-    // Wait the end of the operation
-    wait_end_operation(pio, sm);
+    // System clock cycles per BDC cycle, 16.8 fixed point (the clock divider of bdm-data.pio)
+    uint64_t div_256 = is_freq_known ? 2ull*sync_cycles : (256ull*sys_hz) / PIO_FREQ;
+    uint64_t sys_cycles = (bdm_burst_max_cycles(frame_buffer, count) * div_256) >> 8;
 
-    uint received_data = 0;
-    // Read data from rx fifo
-    if(!pio_sm_is_rx_fifo_empty(pio, sm))
+    return (uint32_t)(sys_cycles / (sys_hz / MHZ)) + BURST_MARGIN_US;
+}
+
+//! Execute a burst of BDM frames
+//!
+//! @param count     : number of frames
+//! @param rx        : where to save received data (NULL to discard it)
+//! @param rx_size   : DMA_SIZE_8 to save one byte per frame, DMA_SIZE_32 for one word per frame
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    == \ref BDM_RC_ACK_TIMEOUT => at least one frame didn't get its ACK pulse \n
+//!    == \ref BDM_RC_NO_CONNECTION => target speed unknown, or the burst didn't end in time \n
+//!    == \ref BDM_RC_ILLEGAL_PARAMS => more than MAX_BDM_FRAMES frames have been queued
+//!
+//! @note
+//!     The whole burst is paced by DMA, the CPU only waits for its completion.
+//!     Frames can have different formats.
+//!     The wait is bounded by the longest wire time of the burst at the current speed,
+//!     an overdue burst is aborted and bdm-data.pio restarted.
+//!     Errors are also kept for bdm_take_error().
+//!
+static uint8_t _bdm_burst_exec(uint count, void *rx, enum dma_channel_transfer_size rx_size)
+{
+    frame_count = 0;
+
+    if (is_frame_overflow || (count > MAX_BDM_FRAMES))
+    {
+        // Nothing is sent
+        is_frame_overflow = false;
+        return _burst_error(BDM_RC_ILLEGAL_PARAMS);
+    }
+
+    if (count == 0)
+    {
+        return BDM_RC_OK;
+    }
+
+    _bdm_prepare();
+
+    if (!is_freq_known)
     {
-        received_data = pio_sm_get(pio, sm);
+        // No answer to SYNC
+        return _burst_error(BDM_RC_NO_CONNECTION);
     }
 
-    return received_data;
+    // bdm-data.pio sets IRQ 0 when an ACK pulse is missing
+    pio_interrupt_clear(pio, 0);
+
+    do_bdm_burst(pio, sm, frame_buffer, count, rx, rx_size);
+
+    if (!wait_end_burst(_burst_timeout_us(count)))
+    {
+        bdm_restart(pio, sm, pio_offset);
+        return _burst_error(BDM_RC_NO_CONNECTION);
+    }
+
+    if (pio_interrupt_get(pio, 0))
+    {
+        return _burst_error(BDM_RC_ACK_TIMEOUT);
+    }
+
+    return BDM_RC_OK;
+}
+
+//! Get and clear the first error of the bursts executed since the last call
+//!
+//! @return
+//!    == \ref BDM_RC_OK => no error       \n
+//!    != \ref BDM_RC_OK => error of the first failed burst, see _bdm_burst_exec()
+//!
+uint8_t bdm_take_error(void)
+{
+    uint8_t error = burst_error;
+
+    burst_error = BDM_RC_OK;
+
+    return error;
+}
+
+//! Execute BDM command in data_buffer
+//!
+//! @param received_data : where to save received data (NULL to discard it)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+uint8_t bdm_command_exec(uint *received_data)
+{
+    _queue_frame(_make_data(), data_buffer[TX_BYTE_COUNT], data_buffer[RX_BYTE_COUNT]);
+
+    return _bdm_burst_exec(1, received_data, DMA_SIZE_32);
 }
 
 //=====================================================================================
 // BDM commands
 //=====================================================================================
-void bdm_cmd_sync(void)
+//! Measure the target speed with SYNC and set the bdm-data clock accordingly
+//!
+//! @return
+//!     true if the target answered
+//!
+//! @note
+//!     bdm-sync.pio runs at full system clock and the response is averaged over SYNC_AVERAGE SYNCs.
+//!     The speed is kept as a fixed point PIO clock divider, no float math is involved.
+//!     If the target doesn't answer, the previous speed is kept.
+//!
+bool bdm_cmd_sync(void)
 {
-    if(!is_sm_init)
+    bdm_pio_init();
+
+    uint32_t sys_mhz = clock_get_hz(clk_sys) / MHZ;
+    uint32_t total_cycles = 0;
+    uint loops = 0;
+
+    for (int i=0; i<SYNC_AVERAGE; i++)
     {
-        // Get first free state machine in PIO 0
-        uint sm = pio_claim_unused_sm(pio, true);
+        // Execute "bdm-sync.pio" program and return the response length
+        loops = sync(sync_pio, sync_sm, sync_offset, SYNC_LOW_US*sys_mhz, SYNC_TIMEOUT_US*sys_mhz/2);
 
-        is_sm_init = true;
+        if (loops == 0)
+        {
+            break;
+        }
+
+        total_cycles += 2*loops + SYNC_OFFSET;
+    }
+
+    // Give the pin back to bdm-data.pio
+    pio_gpio_init(pio, DATA_PIN);
+
+    if (loops == 0)
+    {
+        // No response
+        return false;
     }
 
-    // Overwrite pio instruction memory with "bdm-sync.pio" program, execute it and return ticks
-    ticks = (uint16_t)sync(pio, sm, SYNC_FREQ);
+    sync_cycles = (total_cycles + SYNC_AVERAGE/2) / SYNC_AVERAGE;
 
-    // 1 "tick" corresponds to 2 pio instruction cycles, since state machine increment "tick" every 2 instruction cycles
-    // T_measured = ticks * T_tick, where T_tick = 2 * T_pio = 2 * (1/F_pio) = 2 * (1/2MHZ) = 1us.
-    // T_measured corresponds to 128 MCU clock cycles, so T_MCU = T_measured / 128
-    // Finally F_MCU = 1/T_MCU = (1/T_measured) * 128 
-    float T_measured_us = (float)(ticks * 2 * SYNC_PERIOD);
-    // F_MCU is in HZ
-    float F_MCU = (1/T_measured_us) * 128 * MHZ;
+    // The SYNC response lasts 128 BDC cycles and bdm-data.pio needs 1 PIO cycle = 1 BDC cycle,
+    // so the clock divider is sync_cycles/128. In 16.8 fixed point: sync_cycles*256/128.
+    uint32_t div_256 = (2*total_cycles + SYNC_AVERAGE/2) / SYNC_AVERAGE;
 
-    pio_freq = F_MCU;
+    // bdm-data.pio is still loaded, only its clock has to follow the new speed
+    bdm_set_clkdiv(pio, sm, div_256);
 
-    // Pio memory has been ovewritten, so it needs to be re-initialized
-    is_bdm_data_init = false;
     is_freq_known = true;
+
+    return true;
+}
+
+// Use a SYNC length given in system clock cycles
+static void _set_sync_cycles(uint32_t cycles)
+{
+    sync_cycles = cycles;
+
+    // Clock divider is sync_cycles/128, in 16.8 fixed point
+    bdm_set_clkdiv(pio, sm, 2*cycles);
+
+    is_freq_known = true;
+}
+
+//! Set the target speed from a SYNC length, instead of measuring it
+//!
+//! @param sync_length : 16-bit Sync value in 60MHz ticks (as \ref bdm_cmd_get_sync_length)
+//!
+void bdm_set_sync_length(uint16_t sync_length)
+{
+    bdm_pio_init();
+
+    _set_sync_cycles((uint32_t)(((uint64_t)sync_length * clock_get_hz(clk_sys) + 30*MHZ) / (60*MHZ)));
+}
+
+//! BDC clock frequencies tried by \ref bdm_guess_speed, in kHz (fastest first)
+static const uint32_t guess_freq_khz[] = {
+    25000, 20000, 16000, 12500, 10000, 8000, 6000, 5000, 4000, 3000, 2000, 1000,
+};
+
+//! Find the target speed by trial and error, for targets that don't answer SYNC
+//!
+//! @return
+//!     true if a speed has been found
+//!
+//! @note
+//!     At each frequency BDCSCR and BDCBKPT are read twice. The speed is accepted when both
+//!     reads agree and ENBDM is set. The ACK protocol is not used during the sweep.
+//!     If no speed is found, the previous speed is kept.
+//!
+bool bdm_guess_speed(void)
+{
+    bdm_pio_init();
+
+    uint32_t saved_cycles   = sync_cycles;
+    bool     saved_ack      = is_ack_enabled;
+    bool     saved_known    = is_freq_known;
+    uint8_t  saved_error    = burst_error;
+    uint32_t sys_hz         = clock_get_hz(clk_sys);
+
+    is_ack_enabled = false;
+
+    for (uint i=0; i<count_of(guess_freq_khz); i++)
+    {
+        uint received_data[4] = { 0 };
+
+        // The SYNC response lasts 128 BDC cycles
+        _set_sync_cycles((uint32_t)(((uint64_t)sys_hz * 128) / (guess_freq_khz[i] * 1000)));
+
+        _queue_frame(READ_STATUS, 1, 1);
+        _queue_frame(READ_STATUS, 1, 1);
+        _queue_frame(READ_BKPT, 1, 2);
+        _queue_frame(READ_BKPT, 1, 2);
+        if (_bdm_burst_exec(4, received_data, DMA_SIZE_32) != BDM_RC_OK)
+        {
+            // Nothing trustworthy was received, try the next frequency
+            continue;
+        }
+
+        uint8_t status = (uint8_t)received_data[0];
+
+        if ((status == (uint8_t)received_data[1]) && (status & HCS_BDCSCR_ENBDM) && (status != 0xFF) &&
+            ((uint16_t)received_data[2] == (uint16_t)received_data[3]))
+        {
+            is_ack_enabled = saved_ack;
+            burst_error    = saved_error;
+            return true;
+        }
+    }
+
+    // Failed tries are not errors
+    burst_error = saved_error;
+
+    if (saved_known)
+    {
+        _set_sync_cycles(saved_cycles);
+    }
+    is_freq_known  = saved_known;
+    is_ack_enabled = saved_ack;
+
+    return false;
+}
+
+//! Try to enable the ACK protocol
+//!
+//! @return
+//!     true if the target answered ACK_ENABLE with an ACK pulse. ACK pulses are then used instead
+//!     of the fixed delay for every command that has one.
+//!
+bool bdm_cmd_ack_enable(void)
+{
+    // ACK_ENABLE is answered with an ACK pulse when the target supports the protocol
+    is_ack_enabled = true;
+
+    uint8_t saved_error = burst_error;
+
+    _queue_frame(ACK_ENABLE, 1, 0);
+
+    if (_bdm_burst_exec(1, NULL, DMA_SIZE_32) != BDM_RC_OK)
+    {
+        // Fall back to WAIT, a missing ACK is not an error here
+        is_ack_enabled = false;
+        burst_error    = saved_error;
+    }
+
+    return is_ack_enabled;
+}
+
+//! Disable the ACK protocol and fall back to the fixed delay (WAIT)
+void bdm_cmd_ack_disable(void)
+{
+    if (is_ack_enabled)
+    {
+        _queue_frame(ACK_DISABLED, 1, 0);
+        _bdm_burst_exec(1, NULL, DMA_SIZE_32);
+    }
+
+    is_ack_enabled = false;
+}
+
+bool bdm_is_ack_enabled(void)
+{
+    return is_ack_enabled;
+}
+
+//! Time for a number of BDC cycles at the measured speed
+//!
+//! @param bdc_cycles : number of BDC cycles
+//!
+//! @return
+//!     time in system clock cycles (saturated to 16 bit)
+//!
+uint16_t bdm_get_wait_count(uint bdc_cycles)
+{
+    // The SYNC response lasts 128 BDC cycles
+    uint32_t wait_count = (uint32_t)(((uint64_t)sync_cycles * bdc_cycles) / 128);
+
+    if (wait_count > 0xFFFF)
+    {
+        wait_count = 0xFFFF;
+    }
+
+    return (uint16_t)wait_count;
 }
 
 // Return 16-bit Sync value in 60MHz ticks
 uint16_t bdm_cmd_get_sync_length(void)
 {
-    uint16_t sync_length = (uint16_t)60*ticks;
-    return sync_length;
+    uint64_t sync_length = ((uint64_t)sync_cycles * 60 * MHZ) / clock_get_hz(clk_sys);
+
+    if (sync_length > 0xFFFF)
+    {
+        sync_length = 0xFFFF;
+    }
+
+    return (uint16_t)sync_length;
 }
 
 //! Read status register
+//!
 //! @return
-//!     data_buffer: 
-//!     [3]   = status
+//!    == \ref BDM_RC_OK => success, command_buffer[4] = status  \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
 //!
-void bdm_cmd_read_status(uint8_t *command_buffer)
+uint8_t bdm_cmd_read_status(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // 1 byte to transmit
     data_buffer[RX_BYTE_COUNT] = 1; // 1 byte to receive
     data_buffer[COMMAND] = READ_STATUS;
 
-    uint8_t status = (uint8_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // Save received data in command_buffer[4]
-    command_buffer[4] = status;
+    command_buffer[4] = (uint8_t)received_data;
 
-    return;
+    return rc;
 }
 
 //! HCS12/HCS08/RS08/CFV1 -  Write Target BDM Control Register
@@ -173,20 +515,18 @@ void bdm_cmd_read_status(uint8_t *command_buffer)
 //!    == \ref BDM_RC_OK => success       \n
 //!    != \ref BDM_RC_OK => error         \n
 //!
-void bdm_cmd_write_control(uint8_t *command_buffer)
+uint8_t bdm_cmd_write_control(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 2; // 2 byte to transmit
     data_buffer[RX_BYTE_COUNT] = 0; // 0 byte to receive
     data_buffer[COMMAND] = WRITE_CONTROL;
     data_buffer[FIRST_PARAMETER] = command_buffer[5];
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Write BDCBKPT breakpoint register
-void bdm_cmd_write_bkpt(uint8_t addr_h, uint8_t addr_l)
+uint8_t bdm_cmd_write_bkpt(uint8_t addr_h, uint8_t addr_l)
 {
     data_buffer[TX_BYTE_COUNT] = 3; // 3 byte to transmit
     data_buffer[RX_BYTE_COUNT] = 0; // 0 byte to receive
@@ -194,179 +534,176 @@ void bdm_cmd_write_bkpt(uint8_t addr_h, uint8_t addr_l)
     data_buffer[FIRST_PARAMETER] = addr_h;
     data_buffer[SECOND_PARAMETER] = addr_l;
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Read BDCBKPT breakpoint register
-void bdm_cmd_read_bkpt(uint8_t *command_buffer)
+uint8_t bdm_cmd_read_bkpt(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // 1 byte to transmit
     data_buffer[RX_BYTE_COUNT] = 2; // 2 byte to receive
     data_buffer[COMMAND] = READ_BKPT;
 
-    uint16_t bkpt_register = (uint16_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
-    command_buffer[3] = (uint8_t)(bkpt_register>>8);
-    command_buffer[4] = (uint8_t)(bkpt_register&0xFF);
+    command_buffer[3] = (uint8_t)(received_data>>8);
+    command_buffer[4] = (uint8_t)(received_data&0xFF);
 
-    return;
+    return rc;
 }
 
 // Reset target
-void bdm_cmd_reset(void)
+uint8_t bdm_cmd_reset(void)
 {
-    bdm_cmd_write_byte((uint8_t)(HCS08_SBDFR_DEFAULT>>8), (uint8_t)(HCS08_SBDFR_DEFAULT&0xff), HCS_SBDFR_BDFR);
+    uint8_t rc = bdm_cmd_write_byte((uint8_t)(HCS08_SBDFR_DEFAULT>>8), (uint8_t)(HCS08_SBDFR_DEFAULT&0xff), HCS_SBDFR_BDFR);
+
+    // Reset disables the ACK protocol in the target
+    is_ack_enabled = false;
 
-    return;
+    return rc;
 }
 
 // Execute one user instruction at the address in the PC, then return 
 // to Active Background Mod
-void bdm_cmd_trace(void)
+uint8_t bdm_cmd_trace(void)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // 1 byte to transmit
     data_buffer[RX_BYTE_COUNT] = 0; // 0 byte to receive
     data_buffer[COMMAND] = TRACE1;
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Start executing user program
-void bdm_cmd_go(void)
+uint8_t bdm_cmd_go(void)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // 1 byte to transmit
     data_buffer[RX_BYTE_COUNT] = 0; // 0 byte to receive
     data_buffer[COMMAND] = GO;
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Set target in active background mode
-void bdm_cmd_halt(void)
+uint8_t bdm_cmd_halt(void)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // 1 byte to transmit
     data_buffer[RX_BYTE_COUNT] = 0; // 0 byte to receive
     data_buffer[COMMAND] = BACKGROUND;
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Read register A
-void bdm_cmd_read_a(uint8_t *command_buffer)
+uint8_t bdm_cmd_read_a(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // Transmit 1 bytes
     data_buffer[RX_BYTE_COUNT] = 1;
     data_buffer[COMMAND] = READ_A;
 
-    uint8_t reg_a = (uint8_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // 8 bit value
     command_buffer[3] = 0;
-    command_buffer[4] = reg_a;
+    command_buffer[4] = (uint8_t)received_data;
 
-    return;
+    return rc;
 }
 
 // Read register CCR
-void bdm_cmd_read_ccr(uint8_t *command_buffer)
+uint8_t bdm_cmd_read_ccr(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // Transmit 1 bytes
     data_buffer[RX_BYTE_COUNT] = 1;
     data_buffer[COMMAND] = READ_CCR;
 
-    uint8_t reg_ccr = (uint8_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // 8 bit value
     command_buffer[3] = 0;
-    command_buffer[4] = reg_ccr;
+    command_buffer[4] = (uint8_t)received_data;
 
-    return;
+    return rc;
 }
 
 // Read register PC
-void bdm_cmd_read_pc(uint8_t *command_buffer)
+uint8_t bdm_cmd_read_pc(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // Transmit 1 bytes
     data_buffer[RX_BYTE_COUNT] = 2;
     data_buffer[COMMAND] = READ_PC;
 
-    uint16_t reg_ccr = (uint16_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // 16 bit value
-    command_buffer[3] = (uint8_t)(reg_ccr>>8);
-    command_buffer[4] = (uint8_t)(reg_ccr&0xFF);
+    command_buffer[3] = (uint8_t)(received_data>>8);
+    command_buffer[4] = (uint8_t)(received_data&0xFF);
 
-    return;
+    return rc;
 }
 
 // Read register HX
-void bdm_cmd_read_hx(uint8_t *command_buffer)
+uint8_t bdm_cmd_read_hx(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // Transmit 1 bytes
     data_buffer[RX_BYTE_COUNT] = 2;
     data_buffer[COMMAND] = READ_HX;
 
-    uint16_t reg_hx = (uint16_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // 16 bit value
-    command_buffer[3] = (uint8_t)(reg_hx>>8);
-    command_buffer[4] = (uint8_t)(reg_hx&0xFF);
+    command_buffer[3] = (uint8_t)(received_data>>8);
+    command_buffer[4] = (uint8_t)(received_data&0xFF);
 
-    return;
+    return rc;
 }
 
 // Read register SP
-void bdm_cmd_read_sp(uint8_t *command_buffer)
+uint8_t bdm_cmd_read_sp(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 1; // Transmit 1 bytes
     data_buffer[RX_BYTE_COUNT] = 2;
     data_buffer[COMMAND] = READ_SP;
 
-    uint16_t reg_sp = (uint16_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // 16 bit value
-    command_buffer[3] = (uint8_t)(reg_sp>>8);
-    command_buffer[4] = (uint8_t)(reg_sp&0xFF);
+    command_buffer[3] = (uint8_t)(received_data>>8);
+    command_buffer[4] = (uint8_t)(received_data&0xFF);
 
-    return;
+    return rc;
 }
 
 // Write register A
-void bdm_cmd_write_a(uint8_t *command_buffer)
+uint8_t bdm_cmd_write_a(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 2; // Transmit 2 bytes
     data_buffer[RX_BYTE_COUNT] = 0;
     data_buffer[COMMAND] = WRITE_A;
     data_buffer[FIRST_PARAMETER] = command_buffer[7];   // 8 bit register
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Write register CCR
-void bdm_cmd_write_ccr(uint8_t *command_buffer)
+uint8_t bdm_cmd_write_ccr(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 2; // Transmit 2 bytes
     data_buffer[RX_BYTE_COUNT] = 0;
     data_buffer[COMMAND] = WRITE_CCR;
     data_buffer[FIRST_PARAMETER] = command_buffer[7];   // 8 bit register
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Write register PC
-void bdm_cmd_write_pc(uint8_t *command_buffer)
+uint8_t bdm_cmd_write_pc(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 3; // Transmit 3 bytes
     data_buffer[RX_BYTE_COUNT] = 0;
@@ -374,13 +711,11 @@ void bdm_cmd_write_pc(uint8_t *command_buffer)
     data_buffer[FIRST_PARAMETER] = command_buffer[6];
     data_buffer[SECOND_PARAMETER] = command_buffer[7];  // 16 bit register
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Write register HX
-void bdm_cmd_write_hx(uint8_t *command_buffer)
+uint8_t bdm_cmd_write_hx(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 3; // Transmit 3 bytes
     data_buffer[RX_BYTE_COUNT] = 0;
@@ -388,13 +723,11 @@ void bdm_cmd_write_hx(uint8_t *command_buffer)
     data_buffer[FIRST_PARAMETER] = command_buffer[6];
     data_buffer[SECOND_PARAMETER] = command_buffer[7];  // 16 bit register
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Write register SP
-void bdm_cmd_write_sp(uint8_t *command_buffer)
+uint8_t bdm_cmd_write_sp(uint8_t *command_buffer)
 {
     data_buffer[TX_BYTE_COUNT] = 3; // Transmit 3 bytes
     data_buffer[RX_BYTE_COUNT] = 0;
@@ -402,14 +735,12 @@ void bdm_cmd_write_sp(uint8_t *command_buffer)
     data_buffer[FIRST_PARAMETER] = command_buffer[6];
     data_buffer[SECOND_PARAMETER] = command_buffer[7];  // 16 bit register
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 
 // Write an 8 bit data word to 16 bit register
-void bdm_cmd_write_byte(uint8_t addr_h, uint8_t addr_l, uint8_t data)
+uint8_t bdm_cmd_write_byte(uint8_t addr_h, uint8_t addr_l, uint8_t data)
 {
     data_buffer[TX_BYTE_COUNT] = 4; // Transmit 4 bytes
     data_buffer[RX_BYTE_COUNT] = 0;
@@ -418,26 +749,22 @@ void bdm_cmd_write_byte(uint8_t addr_h, uint8_t addr_l, uint8_t data)
     data_buffer[SECOND_PARAMETER] = addr_l; // Address L
     data_buffer[THIRD_PARAMETER] = data;
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Write an 8 bit data to the next memory location (in relation to the last location written)
-void bdm_cmd_write_next(uint8_t data)
+uint8_t bdm_cmd_write_next(uint8_t data)
 {
     data_buffer[TX_BYTE_COUNT] = 2;
     data_buffer[RX_BYTE_COUNT] = 0;
     data_buffer[COMMAND] = WRITE_NEXT;
     data_buffer[FIRST_PARAMETER] = data;
 
-    bdm_command_exec();
-
-    return;
+    return bdm_command_exec(NULL);
 }
 
 // Read an 8 bit data word to 16 bit register
-void bdm_cmd_read_byte(uint8_t addr_h, uint8_t addr_l, uint8_t* data_ptr)
+uint8_t bdm_cmd_read_byte(uint8_t addr_h, uint8_t addr_l, uint8_t* data_ptr)
 {
     data_buffer[TX_BYTE_COUNT] = 3; 
     data_buffer[RX_BYTE_COUNT] = 1;
@@ -445,25 +772,396 @@ void bdm_cmd_read_byte(uint8_t addr_h, uint8_t addr_l, uint8_t* data_ptr)
     data_buffer[FIRST_PARAMETER] = addr_h;   // Address H
     data_buffer[SECOND_PARAMETER] = addr_l; // Address L
 
-    uint8_t read_byte = (uint8_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // Save read value into the command_buffer
-    data_ptr[0] = read_byte;
+    data_ptr[0] = (uint8_t)received_data;
 
-    return;
+    return rc;
 }
 
 // Read an 8 bit data from the next memory location (in relation to the last location read)
-void bdm_cmd_read_next(uint8_t* data_ptr)
+uint8_t bdm_cmd_read_next(uint8_t* data_ptr)
 {
     data_buffer[TX_BYTE_COUNT] = 1; 
     data_buffer[RX_BYTE_COUNT] = 1; 
     data_buffer[COMMAND] = READ_NEXT;
 
-    uint8_t read_byte = (uint8_t)bdm_command_exec();
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
 
     // Save read value into the buffer
-    data_ptr[0] = read_byte;
+    data_ptr[0] = (uint8_t)received_data;
 
-    return;
-}
\ No newline at end of file
+    return rc;
+}
+
+// Read register HX as a 16 bit value
+static uint8_t _read_hx(uint16_t *hx)
+{
+    data_buffer[TX_BYTE_COUNT] = 1;
+    data_buffer[RX_BYTE_COUNT] = 2;
+    data_buffer[COMMAND] = READ_HX;
+
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
+
+    *hx = (uint16_t)received_data;
+
+    return rc;
+}
+
+//! Read a block of memory using READ_BYTE
+//!
+//! @param addr     : address of the first byte
+//! @param count    : number of bytes to read (up to MAX_BDM_FRAMES)
+//! @param data_ptr : where to save read bytes
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+uint8_t bdm_cmd_read_bytes(uint16_t addr, uint8_t count, uint8_t *data_ptr)
+{
+    for (int i=0; i<count; i++)
+    {
+        // READ_BYTE | Address H | Address L
+        _queue_frame(((uint)READ_BYTE<<16) | (uint16_t)(addr+i), 3, 1);
+    }
+
+    return _bdm_burst_exec(count, data_ptr, DMA_SIZE_8);
+}
+
+//! Write a block of memory using WRITE_BYTE
+//!
+//! @param addr     : address of the first byte
+//! @param count    : number of bytes to write (up to MAX_BDM_FRAMES)
+//! @param data_ptr : bytes to write
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+uint8_t bdm_cmd_write_bytes(uint16_t addr, uint8_t count, const uint8_t *data_ptr)
+{
+    for (int i=0; i<count; i++)
+    {
+        // WRITE_BYTE | Address H | Address L | Data
+        _queue_frame(((uint)WRITE_BYTE<<24) | ((uint)(uint16_t)(addr+i)<<8) | data_ptr[i], 4, 0);
+    }
+
+    return _bdm_burst_exec(count, NULL, DMA_SIZE_32);
+}
+
+//! Read a block of memory using READ_NEXT
+//!
+//! @param addr     : address of the first byte
+//! @param count    : number of bytes to read (up to MAX_BDM_FRAMES-2)
+//! @param data_ptr : where to save read bytes
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+//! @note
+//!     READ_NEXT pre-increments HX, so HX is loaded with addr-1.
+//!     HX is saved before the transfer and restored afterwards.
+//!     Loading HX, the READ_NEXT frames and restoring HX are executed as a single burst.
+//!
+uint8_t bdm_cmd_read_block(uint16_t addr, uint8_t count, uint8_t *data_ptr)
+{
+    uint16_t saved_hx;
+    uint8_t rc = _read_hx(&saved_hx);
+
+    if (rc != BDM_RC_OK)
+    {
+        return rc;
+    }
+
+    _queue_frame(((uint)WRITE_HX<<16) | (uint16_t)(addr-1), 3, 0);
+    for (int i=0; i<count; i++)
+    {
+        _queue_frame(READ_NEXT, 1, 1);
+    }
+    _queue_frame(((uint)WRITE_HX<<16) | saved_hx, 3, 0);
+
+    rc = _bdm_burst_exec(count+2, rx_buffer, DMA_SIZE_8);
+
+    // Skip the dummy byte of the first WRITE_HX
+    memcpy(data_ptr, rx_buffer+1, count);
+
+    return rc;
+}
+
+//! Write a block of memory using WRITE_NEXT
+//!
+//! @param addr     : address of the first byte
+//! @param count    : number of bytes to write (up to MAX_BDM_FRAMES-2)
+//! @param data_ptr : bytes to write
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+//! @note
+//!     WRITE_NEXT pre-increments HX, so HX is loaded with addr-1.
+//!     HX is saved before the transfer and restored afterwards.
+//!     Loading HX, the WRITE_NEXT frames and restoring HX are executed as a single burst.
+//!
+uint8_t bdm_cmd_write_block(uint16_t addr, uint8_t count, const uint8_t *data_ptr)
+{
+    uint16_t saved_hx;
+    uint8_t rc = _read_hx(&saved_hx);
+
+    if (rc != BDM_RC_OK)
+    {
+        return rc;
+    }
+
+    _queue_frame(((uint)WRITE_HX<<16) | (uint16_t)(addr-1), 3, 0);
+    for (int i=0; i<count; i++)
+    {
+        // WRITE_NEXT | Data
+        _queue_frame(((uint)WRITE_NEXT<<8) | data_ptr[i], 2, 0);
+    }
+    _queue_frame(((uint)WRITE_HX<<16) | saved_hx, 3, 0);
+
+    return _bdm_burst_exec(count+2, NULL, DMA_SIZE_32);
+}
+
+//! Write bytes at unrelated addresses using WRITE_BYTE
+//!
+//! @param addr     : address of each byte
+//! @param data_ptr : bytes to write
+//! @param count    : number of bytes (up to MAX_BDM_FRAMES)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+//! @note
+//!     The bytes are written in order, as a single burst (e.g. a register command sequence).
+//!
+uint8_t bdm_cmd_write_scattered(const uint16_t *addr, const uint8_t *data_ptr, uint count)
+{
+    for (uint i=0; i<count; i++)
+    {
+        // WRITE_BYTE | Address H | Address L | Data
+        _queue_frame(((uint)WRITE_BYTE<<24) | ((uint)addr[i]<<8) | data_ptr[i], 4, 0);
+    }
+
+    return _bdm_burst_exec(count, NULL, DMA_SIZE_32);
+}
+
+//! Read bytes at unrelated addresses using READ_BYTE
+//!
+//! @param addr     : address of each byte
+//! @param data_ptr : where to save read bytes
+//! @param count    : number of bytes (up to MAX_BDM_FRAMES)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+//! @note
+//!     READ_BYTE doesn't need the target halted, the bytes are read as a single burst.
+//!
+uint8_t bdm_cmd_read_scattered(const uint16_t *addr, uint8_t *data_ptr, uint count)
+{
+    for (uint i=0; i<count; i++)
+    {
+        // READ_BYTE | Address H | Address L
+        _queue_frame(((uint)READ_BYTE<<16) | addr[i], 3, 1);
+    }
+
+    return _bdm_burst_exec(count, data_ptr, DMA_SIZE_8);
+}
+
+//! Frequency of the target BDC clock, from the SYNC measurement
+//!
+//! @return
+//!     frequency in Hz, 0 if the speed is unknown
+//!
+uint32_t bdm_get_bdc_freq(void)
+{
+    if (!is_freq_known || sync_cycles == 0)
+    {
+        return 0;
+    }
+
+    // The SYNC response lasts 128 BDC cycles
+    return (uint32_t)(((uint64_t)clock_get_hz(clk_sys) * 128 + sync_cycles/2) / sync_cycles);
+}
+
+//! Read all the CPU registers
+//!
+//! @param regs : where to save the registers (BDM_REGS_SIZE bytes)\n
+//!               [0] = A, [1] = CCR, [2..3] = PC, [4..5] = HX, [6..7] = SP (big endian)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+//! @note
+//!     The five reads are executed as a single burst.
+//!
+uint8_t bdm_cmd_read_regs(uint8_t *regs)
+{
+    uint received_data[5];
+
+    _queue_frame(READ_A, 1, 1);
+    _queue_frame(READ_CCR, 1, 1);
+    _queue_frame(READ_PC, 1, 2);
+    _queue_frame(READ_HX, 1, 2);
+    _queue_frame(READ_SP, 1, 2);
+
+    uint8_t rc = _bdm_burst_exec(5, received_data, DMA_SIZE_32);
+
+    regs[0] = (uint8_t)received_data[0];
+    regs[1] = (uint8_t)received_data[1];
+    for (int i=0; i<3; i++)
+    {
+        regs[2+2*i] = (uint8_t)(received_data[2+i]>>8);
+        regs[3+2*i] = (uint8_t)received_data[2+i];
+    }
+
+    return rc;
+}
+
+//! Execute one instruction (TRACE1) and read the registers
+//!
+//! @param regs   : where to save BDCSCR and the registers\n
+//!                 [0] = BDCSCR, [1..8] = registers as \ref bdm_cmd_read_regs\n
+//!                 Only [3..4] = PC is written when is_all is false
+//! @param is_all : read all the registers, else only PC
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    == \ref BDM_RC_ACK_TIMEOUT => at least one frame didn't get its ACK pulse
+//!
+//! @note
+//!     The step and the reads are executed as a single burst.
+//!     BDCSCR tells whether the target is back in active background mode.
+//!
+uint8_t bdm_cmd_trace_regs(uint8_t *regs, bool is_all)
+{
+    uint received_data[7];
+    uint count;
+
+    _queue_frame(TRACE1, 1, 0);
+    _queue_frame(READ_STATUS, 1, 1);
+    if (is_all)
+    {
+        _queue_frame(READ_A, 1, 1);
+        _queue_frame(READ_CCR, 1, 1);
+        _queue_frame(READ_PC, 1, 2);
+        _queue_frame(READ_HX, 1, 2);
+        _queue_frame(READ_SP, 1, 2);
+        count = 7;
+    }
+    else
+    {
+        _queue_frame(READ_PC, 1, 2);
+        count = 3;
+    }
+
+    uint8_t rc = _bdm_burst_exec(count, received_data, DMA_SIZE_32);
+
+    regs[0] = (uint8_t)received_data[1];
+    if (is_all)
+    {
+        regs[1] = (uint8_t)received_data[2];
+        regs[2] = (uint8_t)received_data[3];
+        for (int i=0; i<3; i++)
+        {
+            regs[3+2*i] = (uint8_t)(received_data[4+i]>>8);
+            regs[4+2*i] = (uint8_t)received_data[4+i];
+        }
+    }
+    else
+    {
+        regs[3] = (uint8_t)(received_data[2]>>8);
+        regs[4] = (uint8_t)received_data[2];
+    }
+
+    return rc;
+}
+
+//! Execute a BDM command given as bytes
+//!
+//! @param tx_ptr   : command code and parameters
+//! @param tx_count : number of bytes to transmit (1 to 4)
+//! @param rx_count : number of bytes to receive (0 to 2)
+//! @param rx_data  : where to save received data, right aligned (NULL to discard it)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+uint8_t bdm_cmd_raw(const uint8_t *tx_ptr, uint8_t tx_count, uint8_t rx_count, uint *rx_data)
+{
+    uint data = 0;
+
+    for (int i=0; i<tx_count; i++)
+    {
+        data = tx_ptr[i] | (data<<BYTE);
+    }
+
+    _queue_frame(data, tx_count, rx_count);
+
+    return _bdm_burst_exec(1, rx_data, DMA_SIZE_32);
+}
+
+//! Read the BDC status register (BDCSCR)
+uint8_t bdm_get_status(uint8_t *status)
+{
+    data_buffer[TX_BYTE_COUNT] = 1;
+    data_buffer[RX_BYTE_COUNT] = 1;
+    data_buffer[COMMAND] = READ_STATUS;
+
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
+
+    *status = (uint8_t)received_data;
+
+    return rc;
+}
+
+//! Read register A
+uint8_t bdm_get_a(uint8_t *a)
+{
+    data_buffer[TX_BYTE_COUNT] = 1;
+    data_buffer[RX_BYTE_COUNT] = 1;
+    data_buffer[COMMAND] = READ_A;
+
+    uint received_data = 0;
+    uint8_t rc = bdm_command_exec(&received_data);
+
+    *a = (uint8_t)received_data;
+
+    return rc;
+}
+
+//! Start the user program at a given address
+//!
+//! @param pc : address of the first instruction
+//! @param hx : value of HX
+//! @param sp : value of SP
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _bdm_burst_exec()
+//!
+//! @note
+//!     Loading the registers and GO are executed as a single burst.
+//!
+uint8_t bdm_cmd_run(uint16_t pc, uint16_t hx, uint16_t sp)
+{
+    _queue_frame(((uint)WRITE_HX<<16) | hx, 3, 0);
+    _queue_frame(((uint)WRITE_SP<<16) | sp, 3, 0);
+    _queue_frame(((uint)WRITE_PC<<16) | pc, 3, 0);
+    _queue_frame(GO, 1, 0);
+
+    return _bdm_burst_exec(4, NULL, DMA_SIZE_32);
+}
@@ -38,6 +38,8 @@
 //=====================================================================================
 #define BYTE    8   // bits
 #define MAX_BDM_COMMAND_SIZE 6
+#define MAX_BDM_FRAMES  256 // Max number of frames in a single burst
+#define BDM_REGS_SIZE   8   // A, CCR, PC, HX, SP
 
 enum{
     TX_BYTE_COUNT = 0,
@@ -49,38 +51,62 @@ enum{
 };
 
 
-uint bdm_command_exec(void);
+void bdm_pio_init(void);
+uint8_t bdm_command_exec(uint *received_data);
 
 //=====================================================================================
 // BDM commands
 //=====================================================================================
-void bdm_cmd_sync(void);
+bool bdm_cmd_sync(void);
+void bdm_set_sync_length(uint16_t sync_length);
+bool bdm_guess_speed(void);
+uint8_t bdm_take_error(void);
 uint16_t bdm_cmd_get_sync_length(void);
+uint16_t bdm_get_wait_count(uint bdc_cycles);
 
-void bdm_cmd_read_status(uint8_t *command_buffer);
-void bdm_cmd_write_control(uint8_t *command_buffer);
-
-void bdm_cmd_write_bkpt(uint8_t addr_h, uint8_t addr_l);
-void bdm_cmd_read_bkpt(uint8_t *data_ptr);
-
-void bdm_cmd_reset(void);
-void bdm_cmd_trace(void);
-void bdm_cmd_go(void);
-void bdm_cmd_halt(void);
-
-void bdm_cmd_read_a(uint8_t *command_buffer);
-void bdm_cmd_read_ccr(uint8_t *command_buffer);
-void bdm_cmd_read_pc(uint8_t *command_buffer);
-void bdm_cmd_read_hx(uint8_t *command_buffer);
-void bdm_cmd_read_sp(uint8_t *command_buffer);
-
-void bdm_cmd_write_a(uint8_t *command_buffer);
-void bdm_cmd_write_ccr(uint8_t *command_buffer);
-void bdm_cmd_write_pc(uint8_t *command_buffer);
-void bdm_cmd_write_hx(uint8_t *command_buffer);
-void bdm_cmd_write_sp(uint8_t *command_buffer);
-
-void bdm_cmd_write_byte(uint8_t addr_h, uint8_t addr_l, uint8_t data);
-void bdm_cmd_write_next(uint8_t data);
-void bdm_cmd_read_byte(uint8_t addr_h, uint8_t addr_l, uint8_t *data_ptr);
-void bdm_cmd_read_next(uint8_t *data_ptr);
\ No newline at end of file
+bool bdm_cmd_ack_enable(void);
+void bdm_cmd_ack_disable(void);
+bool bdm_is_ack_enabled(void);
+
+uint8_t bdm_cmd_read_status(uint8_t *command_buffer);
+uint8_t bdm_cmd_write_control(uint8_t *command_buffer);
+
+uint8_t bdm_cmd_write_bkpt(uint8_t addr_h, uint8_t addr_l);
+uint8_t bdm_cmd_read_bkpt(uint8_t *data_ptr);
+
+uint8_t bdm_cmd_reset(void);
+uint8_t bdm_cmd_trace(void);
+uint8_t bdm_cmd_go(void);
+uint8_t bdm_cmd_halt(void);
+
+uint8_t bdm_cmd_read_a(uint8_t *command_buffer);
+uint8_t bdm_cmd_read_ccr(uint8_t *command_buffer);
+uint8_t bdm_cmd_read_pc(uint8_t *command_buffer);
+uint8_t bdm_cmd_read_hx(uint8_t *command_buffer);
+uint8_t bdm_cmd_read_sp(uint8_t *command_buffer);
+
+uint8_t bdm_cmd_write_a(uint8_t *command_buffer);
+uint8_t bdm_cmd_write_ccr(uint8_t *command_buffer);
+uint8_t bdm_cmd_write_pc(uint8_t *command_buffer);
+uint8_t bdm_cmd_write_hx(uint8_t *command_buffer);
+uint8_t bdm_cmd_write_sp(uint8_t *command_buffer);
+
+uint8_t bdm_cmd_write_byte(uint8_t addr_h, uint8_t addr_l, uint8_t data);
+uint8_t bdm_cmd_write_next(uint8_t data);
+uint8_t bdm_cmd_read_byte(uint8_t addr_h, uint8_t addr_l, uint8_t *data_ptr);
+uint8_t bdm_cmd_read_next(uint8_t *data_ptr);
+
+uint8_t bdm_cmd_read_bytes(uint16_t addr, uint8_t count, uint8_t *data_ptr);
+uint8_t bdm_cmd_write_bytes(uint16_t addr, uint8_t count, const uint8_t *data_ptr);
+uint8_t bdm_cmd_read_block(uint16_t addr, uint8_t count, uint8_t *data_ptr);
+uint8_t bdm_cmd_write_block(uint16_t addr, uint8_t count, const uint8_t *data_ptr);
+
+uint8_t bdm_get_status(uint8_t *status);
+uint8_t bdm_get_a(uint8_t *a);
+uint8_t bdm_cmd_run(uint16_t pc, uint16_t hx, uint16_t sp);
+uint8_t bdm_cmd_write_scattered(const uint16_t *addr, const uint8_t *data_ptr, uint count);
+uint8_t bdm_cmd_read_scattered(const uint16_t *addr, uint8_t *data_ptr, uint count);
+uint32_t bdm_get_bdc_freq(void);
+uint8_t bdm_cmd_read_regs(uint8_t *regs);
+uint8_t bdm_cmd_trace_regs(uint8_t *regs, bool is_all);
+uint8_t bdm_cmd_raw(const uint8_t *tx_ptr, uint8_t tx_count, uint8_t rx_count, uint *rx_data);
@@ -0,0 +1,213 @@
+#include "cache.h"
+
+#include <string.h>
+
+#include "config.h"
+
+#include "bdm.h"
+
+typedef struct {
+    bool     is_valid;
+    uint16_t addr;                      //!< Address of the first byte
+    uint8_t  data[CACHE_BLOCK_SIZE];
+} cache_block_t;
+
+typedef struct {
+    uint16_t start;
+    uint16_t end;                       //!< Last address (included)
+} cache_region_t;
+
+static cache_block_t blocks[CACHE_BLOCKS];
+
+// Uncacheable regions (HCS08 direct page and high page registers by default)
+static cache_region_t regions[CACHE_REGIONS] = {
+    { 0x0000, 0x007F },
+    { 0x1800, 0x18FF },
+    { 0xFFFF, 0x0000 },                 // Unused (start > end)
+    { 0xFFFF, 0x0000 },
+};
+
+// Cache enabled by the host?
+static bool is_enabled = true;
+// Target is known to be halted?
+static bool is_halted = false;
+
+// Round an address down to the start of its block
+static inline uint16_t _block_addr(uint addr)
+{
+    return (uint16_t)(addr & ~(CACHE_BLOCK_SIZE-1));
+}
+
+// Block of the cache an address maps to
+static inline cache_block_t *_block(uint16_t block_addr)
+{
+    return &blocks[(block_addr / CACHE_BLOCK_SIZE) & (CACHE_BLOCKS-1)];
+}
+
+// Check that a range doesn't overlap any uncacheable region
+static bool _is_cacheable(uint first, uint last)
+{
+    for (int i=0; i<CACHE_REGIONS; i++)
+    {
+        if ((first <= regions[i].end) && (last >= regions[i].start))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//! Enable or disable the cache
+void cache_set_enabled(bool enabled)
+{
+    is_enabled = enabled;
+    cache_invalidate();
+}
+
+//! Set an uncacheable region
+//!
+//! @param index : region number (< CACHE_REGIONS)
+//! @param start : first address
+//! @param end   : last address (included). start > end disables the region
+//!
+//! @return false if index is out of range
+//!
+bool cache_set_region(uint index, uint16_t start, uint16_t end)
+{
+    if (index >= CACHE_REGIONS)
+    {
+        return false;
+    }
+
+    regions[index].start = start;
+    regions[index].end   = end;
+    cache_invalidate();
+
+    return true;
+}
+
+//! Track the target run state. Leaving the halted state drops the whole cache
+void cache_set_halted(bool halted)
+{
+    if (!halted)
+    {
+        cache_invalidate();
+    }
+
+    is_halted = halted;
+}
+
+//! Drop the whole cache
+void cache_invalidate(void)
+{
+    for (int i=0; i<CACHE_BLOCKS; i++)
+    {
+        blocks[i].is_valid = false;
+    }
+}
+
+// Drop the blocks holding first..last (last <= 0xFFFF)
+static void _invalidate_blocks(uint first, uint last)
+{
+    for (uint block_addr = _block_addr(first); block_addr <= last; block_addr += CACHE_BLOCK_SIZE)
+    {
+        cache_block_t *block = _block((uint16_t)block_addr);
+
+        if (block->addr == (uint16_t)block_addr)
+        {
+            block->is_valid = false;
+        }
+    }
+}
+
+//! Drop the blocks holding a range (e.g. after a write)
+//!
+//! @note
+//!     A range wrapping around the address space is dropped in two parts, 0x0000 onwards included.
+//!
+void cache_invalidate_range(uint16_t addr, uint32_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    if (count > 0xFFFF)
+    {
+        cache_invalidate();
+        return;
+    }
+
+    uint last = (uint)addr + count - 1;
+
+    if (last > 0xFFFF)
+    {
+        _invalidate_blocks(0, last - 0x10000);
+        last = 0xFFFF;
+    }
+
+    _invalidate_blocks(addr, last);
+}
+
+//! Read memory through the cache
+//!
+//! @param addr     : address of the first byte
+//! @param count    : number of bytes
+//! @param data_ptr : where to save read bytes
+//! @param is_served : true if the read has been served by the cache (missing blocks are fetched),
+//!                    false if the cache can't be used (target running, uncacheable region): nothing is read
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => a missing block couldn't be fetched, see bdm_cmd_read_block()
+//!
+//! @note
+//!     Missing blocks are fetched with READ_NEXT, so the target must be halted.
+//!     A block is only kept when its fetch succeeded.
+//!
+uint8_t cache_read(uint16_t addr, uint8_t count, uint8_t *data_ptr, bool *is_served)
+{
+    *is_served = true;
+
+    if (count == 0)
+    {
+        return BDM_RC_OK;
+    }
+
+    uint first = _block_addr(addr);
+    uint last  = (uint)addr + count - 1;
+
+    // Reads wrapping around the address space are not cached
+    if (!is_enabled || !is_halted || (last > 0xFFFF) || !_is_cacheable(first, last | (CACHE_BLOCK_SIZE-1)))
+    {
+        *is_served = false;
+        return BDM_RC_OK;
+    }
+
+    for (uint block_addr = first; block_addr <= last; block_addr += CACHE_BLOCK_SIZE)
+    {
+        cache_block_t *block = _block((uint16_t)block_addr);
+
+        if (!block->is_valid || (block->addr != (uint16_t)block_addr))
+        {
+            block->is_valid = false;
+
+            uint8_t rc = bdm_cmd_read_block((uint16_t)block_addr, CACHE_BLOCK_SIZE, block->data);
+
+            if (rc != BDM_RC_OK)
+            {
+                return rc;
+            }
+            block->addr     = (uint16_t)block_addr;
+            block->is_valid = true;
+        }
+
+        // Copy the part of the block inside the range
+        uint from = (block_addr > addr) ? block_addr : addr;
+        uint to   = (block_addr + CACHE_BLOCK_SIZE - 1 < last) ? block_addr + CACHE_BLOCK_SIZE - 1 : last;
+
+        memcpy(data_ptr + (from - addr), block->data + (from - block_addr), to - from + 1);
+    }
+
+    return BDM_RC_OK;
+}
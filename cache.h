@@ -0,0 +1,23 @@
+#ifndef CACHE_H_
+#define CACHE_H_
+
+#include "pico/stdlib.h"
+
+//--------------------------------------------------------------------+
+// TARGET MEMORY CACHE
+//--------------------------------------------------------------------+
+// Direct mapped cache of target memory, only used while the target is halted.
+// Regions holding peripheral registers are never cached.
+//
+#define CACHE_BLOCK_SIZE    32      // Bytes per block (power of 2)
+#define CACHE_BLOCKS        64      // Number of blocks (power of 2)
+#define CACHE_REGIONS       4       // Max number of uncacheable regions
+
+void cache_set_enabled(bool enabled);
+bool cache_set_region(uint index, uint16_t start, uint16_t end);
+void cache_set_halted(bool halted);
+void cache_invalidate(void);
+void cache_invalidate_range(uint16_t addr, uint32_t count);
+uint8_t cache_read(uint16_t addr, uint8_t count, uint8_t *data_ptr, bool *is_served);
+
+#endif /* CACHE_H_ */
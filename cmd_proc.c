@@ -4,6 +4,12 @@
 #include "BDM_options.h"
 
 #include "bdm.h"
+#include "stub.h"
+#include "flash.h"
+#include "cache.h"
+#include "script.h"
+#include "target_mem.h"
+#include "event.h"
 
 //! Options for the BDM
 //!
@@ -83,27 +89,431 @@ static CableStatus_t cable_status =  {
 
    // 32:  CMD_USBDM_WRITE_MEM
    // 33:  CMD_USBDM_READ_MEM
+
+// ---------- Probe specific -------------
+   // 64:  CMD_USBDM_STUB_SETUP
+   // 65:  CMD_USBDM_STUB_PROGRAM
+   // 66:  CMD_USBDM_STUB_WAIT
+   // 67:  CMD_USBDM_FLASH_SETUP
+   // 68:  CMD_USBDM_FLASH_ERASE
+   // 69:  CMD_USBDM_FLASH_PROGRAM
+   // 70:  CMD_USBDM_CACHE_CONFIG
+   // 71:  CMD_USBDM_READ_ALL_REGS
+   // 72:  CMD_USBDM_EXEC_SCRIPT
+   // 73:  CMD_USBDM_CRC32_MEM
+   // 74:  CMD_USBDM_VERIFY_MEM
+   // 75:  CMD_USBDM_FILL_MEM
+   // 76:  CMD_USBDM_BLANK_CHECK_MEM
+   // 77:  CMD_USBDM_WRITE_MEM_EXT
+   // 78:  CMD_USBDM_READ_MEM_EXT
+   // 79:  CMD_USBDM_HALT_EVENT
+   // 80:  CMD_USBDM_LIVE_WATCH
+   // 81:  CMD_USBDM_TRACE
+   // 82:  CMD_USBDM_RUN_UNTIL
 //--------------------------------------------------------------------+
 static USBDM_ErrorCode command_status = BDM_RC_OK;
-static uint8_t response_size = 1;
+static uint16_t response_size = 1;
+// Size of the command being executed ([0] included)
+static uint16_t command_length = 0;
+
+// CPU registers captured when the target was seen entering background mode (see bdm_cmd_read_regs)
+static uint8_t reg_snapshot[BDM_REGS_SIZE];
+static bool is_snapshot_valid = false;
+
+// Background work is pending on core 1 (see command_background_task)
+volatile bool is_background_active = false;
+
+// BDCSCR poll interval while waiting for the target to halt after GO, 0 => no halt event
+static uint32_t halt_poll_us = 0;
+static bool is_halt_watch_armed = false;
+static absolute_time_t next_halt_poll;
+
+// Live watch: target bytes sampled with READ_BYTE while the target runs
+static uint16_t live_watch_addr[LIVE_WATCH_MAX_BYTES];
+static uint8_t  live_watch_count = 0;
+static uint32_t live_watch_period_us = 0;
+static bool is_live_watch_running = false;
+static absolute_time_t next_live_sample;
+
+// Run until a condition is met (CMD_USBDM_RUN_UNTIL)
+typedef struct {
+  uint8_t  mode;                  //!< See \ref RunUntilMode_t
+  uint8_t  condition;             //!< See \ref RunUntilCondition_t
+  uint16_t param1;
+  uint16_t param2;
+  uint16_t hit_count;
+} run_until_t;
+
+static run_until_t run_until;
+static bool is_run_until_armed = false;
+
+// Speed tracking: target commands since the last SYNC, and speed known to be wrong
+static uint commands_since_sync = 0;
+static bool is_speed_stale = false;
+
+//! Find the target speed, then enable ACK if supported
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    == \ref BDM_RC_NO_CONNECTION => the target answered neither SYNC nor the speed guess
+//!
+//! @note
+//!   SYNC first, then the guess sweep if allowed by bdm_option.guessSpeed.
+//!   The result is reflected in cable_status.speed.
+//!
+static uint8_t _find_speed(void)
+{
+  commands_since_sync = 0;
+  is_speed_stale      = false;
+
+  if (bdm_cmd_sync())
+  {
+    cable_status.speed = SPEED_SYNC;
+  }
+  else if (bdm_option.guessSpeed && bdm_guess_speed())
+  {
+    cable_status.speed = SPEED_GUESSED;
+  }
+  else
+  {
+    cable_status.speed = SPEED_NO_INFO;
+    return BDM_RC_NO_CONNECTION;
+  }
+
+  // Use ACK pulses if the target supports them, otherwise fixed delays
+  cable_status.ackn = bdm_cmd_ack_enable() ? ACKN : WAIT;
+
+  cable_status.sync_length = bdm_cmd_get_sync_length();
+  cable_status.wait64_cnt  = bdm_get_wait_count(64);
+  cable_status.wait150_cnt = bdm_get_wait_count(150);
+
+  return BDM_RC_OK;
+}
+
+//! Resync before a target command when the speed may have changed
+//!
+//! @param command : command about to be executed
+//!
+//! @note
+//!   A resync is due after a BDM error or a reset, and every SYNC_COUNT_THRESHOLD commands
+//!   with AUTO_SYNC. bdm_option.autoReconnect tells which commands can do it:
+//!   none, CMD_USBDM_READ_STATUS_REG only, or any target command.
+//!   A user supplied speed is never changed.
+//!
+static void _track_speed(uint8_t command)
+{
+  if ((command <= CMD_USBDM_GET_SPEED) || (cable_status.speed == SPEED_USER_SUPPLIED))
+  {
+    return;
+  }
+
+  commands_since_sync++;
+
+  bool is_due = is_speed_stale || (AUTO_SYNC && (commands_since_sync >= SYNC_COUNT_THRESHOLD));
+
+  switch (bdm_option.autoReconnect)
+  {
+    case AUTOCONNECT_STATUS:
+      is_due = is_due && (command == CMD_USBDM_READ_STATUS_REG);
+      break;
+    case AUTOCONNECT_ALWAYS:
+      break;
+    default:
+      is_due = false;
+      break;
+  }
+
+  if (is_due)
+  {
+    _find_speed();
+  }
+}
+
+//! Track the target run state
+//!
+//! @param halted : the target is known to be halted (BDMACT), or has been started
+//!
+//! @note
+//!   Memory cache and register snapshot are only valid while the target is halted.
+//!   The registers are captured once, when the target is first seen halted.
+//!
+static void _set_halted(bool halted)
+{
+  cache_set_halted(halted);
+
+  if (!halted)
+  {
+    is_snapshot_valid = false;
+  }
+  else if (!is_snapshot_valid)
+  {
+    // A failed read is retried the next time the target is seen halted
+    is_snapshot_valid = (bdm_cmd_read_regs(reg_snapshot) == BDM_RC_OK);
+  }
+}
+
+static void _update_background(void)
+{
+  is_background_active = is_halt_watch_armed || is_live_watch_running;
+}
+
+// A conditional run needs the poll even when the halt event is disabled
+static uint32_t _halt_poll_interval(void)
+{
+  return (halt_poll_us != 0) ? halt_poll_us : HALT_POLL_MIN_US;
+}
+
+//! Start or stop polling BDCSCR for the halt event
+//!
+//! @param armed : the target has been started by GO
+//!
+static void _arm_halt_watch(bool armed)
+{
+  is_halt_watch_armed = armed && ((halt_poll_us != 0) || is_run_until_armed);
+  next_halt_poll      = make_timeout_time_us(_halt_poll_interval());
+
+  _update_background();
+}
+
+//! Evaluate the condition of a conditional run, the target being halted
+//!
+//! @param pc : current PC
+//!
+//! @return true when the target must stay halted
+//!
+static bool _is_run_until_met(uint16_t pc)
+{
+  switch (run_until.condition)
+  {
+    case RUN_UNTIL_HIT_COUNT:
+    {
+      run_until.hit_count++;
+      return run_until.hit_count >= run_until.param1;
+    }
+    case RUN_UNTIL_BYTE_EQUAL:
+    {
+      uint8_t data;
+
+      if (bdm_cmd_read_bytes(run_until.param1, 1, &data) != BDM_RC_OK)
+      {
+        // Can't tell, leave the target halted
+        return true;
+      }
+      return (data & (uint8_t)(run_until.param2>>8)) == (uint8_t)run_until.param2;
+    }
+    case RUN_UNTIL_PC_OUTSIDE:
+    {
+      return (pc < run_until.param1) || (pc > run_until.param2);
+    }
+    default:
+    {
+      return true;
+    }
+  }
+}
+
+//! Restart the target from a breakpoint
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, the target may still be halted
+//!
+//! @note
+//!   The instruction at the breakpoint is stepped first, so GO doesn't hit it again at once.
+//!
+static uint8_t _resume(void)
+{
+  uint8_t rc = bdm_cmd_trace();
+
+  if (rc == BDM_RC_OK)
+  {
+    rc = bdm_cmd_go();
+  }
+  _set_halted(false);
+
+  return rc;
+}
+
+//! Poll BDCSCR, send an \ref EVT_HALT event when the target is seen in background mode
+//!
+//! @note
+//!   EVT_HALT data : [0] = BDCSCR, [1..8] = registers as \ref _cmd_usbdm_read_all_regs
+//!
+static void _poll_halt(void)
+{
+  uint8_t status;
+
+  if ((bdm_get_status(&status) != BDM_RC_OK) || ((status & HCS_BDCSCR_BDMACT) == 0))
+  {
+    next_halt_poll = make_timeout_time_us(_halt_poll_interval());
+    return;
+  }
+
+  _set_halted(true);
+
+  if (!is_snapshot_valid)
+  {
+    // Registers not read, the halt is reported by a later poll
+    next_halt_poll = make_timeout_time_us(_halt_poll_interval());
+    return;
+  }
+
+  if (is_run_until_armed)
+  {
+    if (!_is_run_until_met((uint16_t)((reg_snapshot[2]<<8) | reg_snapshot[3])) && (_resume() == BDM_RC_OK))
+    {
+      next_halt_poll = make_timeout_time_us(_halt_poll_interval());
+      return;
+    }
+    is_run_until_armed = false;
+  }
+
+  _arm_halt_watch(false);
+
+  if (halt_poll_us == 0)
+  {
+    return;
+  }
+
+  event_t *event = event_alloc();
+  if (event != NULL)
+  {
+    event->type    = EVT_HALT;
+    event->size    = 1 + BDM_REGS_SIZE;
+    event->data[0] = status;
+    memcpy(event->data + 1, reg_snapshot, BDM_REGS_SIZE);
+    event_post();
+  }
+}
+
+//! Read the live watch bytes into an \ref EVT_SAMPLE event
+//!
+//! @note
+//!   EVT_SAMPLE data : [0..3] = time of the sample in us (32-bit, wraps), [4..N+3] = watched bytes.\n
+//!   Samples are taken at a fixed rate. When the events are not sent fast enough the
+//!   sample is skipped, the gap shows in the time stamps.
+//!
+static void _sample_live_watch(void)
+{
+  next_live_sample = delayed_by_us(next_live_sample, live_watch_period_us);
+  if (time_reached(next_live_sample))
+  {
+    // Fallen behind (e.g. long command), restart from now instead of bursting
+    next_live_sample = make_timeout_time_us(live_watch_period_us);
+  }
+
+  event_t *event = event_alloc();
+  if (event == NULL)
+  {
+    return;
+  }
+
+  uint32_t now = time_us_32();
+
+  event->type    = EVT_SAMPLE;
+  event->size    = 4 + live_watch_count;
+  event->data[0] = (uint8_t)(now>>24);
+  event->data[1] = (uint8_t)(now>>16);
+  event->data[2] = (uint8_t)(now>>8);
+  event->data[3] = (uint8_t)now;
+  if (bdm_cmd_read_scattered(live_watch_addr, event->data + 4, live_watch_count) == BDM_RC_OK)
+  {
+    // A failed read is dropped like a late sample
+    event_post();
+  }
+}
+
+//! Step the target until the condition of a conditional run is met
+//!
+//! @note
+//!   At most RUN_UNTIL_STEP_CHUNK steps are executed per call, so commands are still served.
+//!   When the condition is met, the target is reported halted as by \ref _poll_halt.
+//!
+static void _step_until(void)
+{
+  for (uint i=0; i<RUN_UNTIL_STEP_CHUNK; i++)
+  {
+    uint8_t regs[1 + BDM_REGS_SIZE];
+
+    if ((bdm_cmd_trace_regs(regs, false) != BDM_RC_OK) || ((regs[0] & HCS_BDCSCR_BDMACT) == 0))
+    {
+      // Target is running (e.g. STOP/WAIT), wait for it like after GO
+      is_run_until_armed = false;
+      _set_halted(false);
+      return;
+    }
+
+    if (_is_run_until_met((uint16_t)((regs[3]<<8) | regs[4])))
+    {
+      is_run_until_armed = false;
+      _poll_halt();
+      return;
+    }
+  }
+}
+
+//! Background work run by core 1 between jobs
+//!
+//! - Polls BDCSCR while the target runs after GO (halt event)
+//! - Steps the target of a conditional run
+//! - Samples the live watch list
+//!
+//! @return true if the target has been accessed
+//!
+//! @note
+//!   Only called while \ref is_background_active is set.
+//!
+bool command_background_task(void)
+{
+  bool is_done = false;
+
+  if (is_live_watch_running && time_reached(next_live_sample))
+  {
+    _sample_live_watch();
+    is_done = true;
+  }
+
+  if (is_run_until_armed && (run_until.mode == RUN_UNTIL_STEP))
+  {
+    _step_until();
+    is_done = true;
+  }
+  else if (is_halt_watch_armed && time_reached(next_halt_poll))
+  {
+    _poll_halt();
+    is_done = true;
+  }
+
+  return is_done;
+}
 
 /*
  *   Processes all commands received over USB
  *
  *   The command is expected to be in \ref command_buffer[1..N]
+ *   command_size is the size of the command, [0] included (see receive_USB_command)
  *
  *   @return Number of bytes left in commandBuffer to be sent back as response.\n
  *          command_buffer[0]    = result code, BDM_RC_OK => success, else failure error code\n
  *          command_buffer[1..N] = command results
  */
-uint8_t command_exec(uint8_t* command_buffer)
+uint16_t command_exec(uint8_t* command_buffer, uint16_t command_size)
 {
-  uint8_t command_size = command_buffer[0];
   BDMCommands command = command_buffer[1];
 
+  command_length = command_size;
+
   // Default response size (maybe will be changed inside a function)
   response_size = 1;
 
+  // Errors of the background work, before this command
+  if (bdm_take_error() != BDM_RC_OK)
+  {
+    is_speed_stale = true;
+  }
+
+  _track_speed((uint8_t)command);
+
   switch((uint8_t)command)
   {
     case CMD_USBDM_GET_COMMAND_STATUS:  //0
@@ -216,6 +626,101 @@ uint8_t command_exec(uint8_t* command_buffer)
       command_status = _cmd_usbdm_read_mem(command_buffer);
       break;
     }
+    case CMD_USBDM_STUB_SETUP:  //64
+    {
+      command_status = _cmd_usbdm_stub_setup(command_buffer);
+      break;
+    }
+    case CMD_USBDM_STUB_PROGRAM:  //65
+    {
+      command_status = _cmd_usbdm_stub_program(command_buffer);
+      break;
+    }
+    case CMD_USBDM_STUB_WAIT:  //66
+    {
+      command_status = _cmd_usbdm_stub_wait(command_buffer);
+      break;
+    }
+    case CMD_USBDM_FLASH_SETUP:  //67
+    {
+      command_status = _cmd_usbdm_flash_setup(command_buffer);
+      break;
+    }
+    case CMD_USBDM_FLASH_ERASE:  //68
+    {
+      command_status = _cmd_usbdm_flash_erase(command_buffer);
+      break;
+    }
+    case CMD_USBDM_FLASH_PROGRAM:  //69
+    {
+      command_status = _cmd_usbdm_flash_program(command_buffer);
+      break;
+    }
+    case CMD_USBDM_CACHE_CONFIG:  //70
+    {
+      command_status = _cmd_usbdm_cache_config(command_buffer);
+      break;
+    }
+    case CMD_USBDM_READ_ALL_REGS:  //71
+    {
+      command_status = _cmd_usbdm_read_all_regs(command_buffer);
+      break;
+    }
+    case CMD_USBDM_EXEC_SCRIPT:  //72
+    {
+      command_status = _cmd_usbdm_exec_script(command_buffer);
+      break;
+    }
+    case CMD_USBDM_CRC32_MEM:  //73
+    {
+      command_status = _cmd_usbdm_crc32_mem(command_buffer);
+      break;
+    }
+    case CMD_USBDM_VERIFY_MEM:  //74
+    {
+      command_status = _cmd_usbdm_verify_mem(command_buffer);
+      break;
+    }
+    case CMD_USBDM_FILL_MEM:  //75
+    {
+      command_status = _cmd_usbdm_fill_mem(command_buffer);
+      break;
+    }
+    case CMD_USBDM_BLANK_CHECK_MEM:  //76
+    {
+      command_status = _cmd_usbdm_blank_check_mem(command_buffer);
+      break;
+    }
+    case CMD_USBDM_WRITE_MEM_EXT:  //77
+    {
+      command_status = _cmd_usbdm_write_mem_ext(command_buffer);
+      break;
+    }
+    case CMD_USBDM_READ_MEM_EXT:  //78
+    {
+      command_status = _cmd_usbdm_read_mem_ext(command_buffer);
+      break;
+    }
+    case CMD_USBDM_HALT_EVENT:  //79
+    {
+      command_status = _cmd_usbdm_halt_event(command_buffer);
+      break;
+    }
+    case CMD_USBDM_LIVE_WATCH:  //80
+    {
+      command_status = _cmd_usbdm_live_watch(command_buffer);
+      break;
+    }
+    case CMD_USBDM_TRACE:  //81
+    {
+      command_status = _cmd_usbdm_trace(command_buffer);
+      break;
+    }
+    case CMD_USBDM_RUN_UNTIL:  //82
+    {
+      command_status = _cmd_usbdm_run_until(command_buffer);
+      break;
+    }
     default: 
     {
       command_status = BDM_RC_FAIL; 
@@ -223,6 +728,25 @@ uint8_t command_exec(uint8_t* command_buffer)
     }
   }
   
+  // A BDM error is the result of the command, unless it has failed by itself or has
+  // reported the error in its response (the handler has then called bdm_take_error()).
+  // A missing ACK may mean the target clock has changed.
+  uint8_t bdm_error = bdm_take_error();
+  if (bdm_error != BDM_RC_OK)
+  {
+    is_speed_stale = true;
+    if (command_status == BDM_RC_OK)
+    {
+      command_status = bdm_error;
+    }
+  }
+
+  // Only the status is sent back on error
+  if (command_status != BDM_RC_OK)
+  {
+    response_size = 1;
+  }
+
   // Save command status in buffer
   command_buffer[0] = command_status;
 
@@ -278,6 +802,10 @@ uint8_t _cmd_usbdm_get_bdm_status(uint8_t* command_buffer)
     case SPEED_SYNC          : status |= S_SYNC_DONE;      break; 
     case SPEED_GUESSED       : status |= S_GUESS_DONE;     break; 
   }
+  if (bdm_is_ack_enabled())
+  {
+    status |= S_ACKN;
+  }
   // Assume power present
   status |= S_POWER_EXT;
 
@@ -303,6 +831,9 @@ static const uint8_t capabilities[] =
    VERSION_MAJOR,             // Extended firmware version number nn.nn.nn
    VERSION_MINOR,
    VERSION_MICRO,
+
+   (uint8_t)(MAX_EXT_COMMAND_SIZE>>8),  // MSB
+   (uint8_t)MAX_EXT_COMMAND_SIZE,       // LSB
 };
 
 //! Returns capability vector for hardware
@@ -310,6 +841,8 @@ static const uint8_t capabilities[] =
 //!  command_buffer                                                \n
 //!   - [1..2] = BDM capability, see cmd_proc.h  \n
 //!   - [3..4] = Maximum command buffer size  \n
+//!   - [5..7] = Extended firmware version    \n
+//!   - [8..9] = Maximum command/response size with the extended framing (see receive_USB_command)
 //!
 uint8_t _cmd_usbdm_get_capabilities(uint8_t* command_buffer) 
 {
@@ -357,32 +890,74 @@ uint8_t _cmd_usbdm_control_pins(uint8_t* command_buffer)
 //! HCS12/HCS08/RS08/CFV1 - Try to connect to the target
 //!
 //! @return
-//!    == \ref BDM_RC_OK => success   
+//!    == \ref BDM_RC_OK => success   \n
+//!    == \ref BDM_RC_NO_CONNECTION => no answer from the target \n
+//!    == \ref BDM_RC_BDM_EN_FAILED => ENBDM can't be set (warning)
 //!
 uint8_t _cmd_usbdm_connect(void)
 {
   // Since we have no control over target's power supply, we can't connect it via software. 
   // To connect the target, press pico's board button and cycle target power supply(turn off->turn on)
-  bdm_cmd_sync();
+  uint8_t rc = _find_speed();
 
-  return BDM_RC_OK;
+  _set_halted(false);
+  is_run_until_armed = false;
+  _arm_halt_watch(false);
+
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+
+  // BDM commands need ENBDM
+  uint8_t status;
+  rc = bdm_get_status(&status);
+  if ((rc == BDM_RC_OK) && ((status & HCS_BDCSCR_ENBDM) == 0))
+  {
+    uint8_t control[2] = { WRITE_CONTROL, (uint8_t)(status | HCS_BDCSCR_ENBDM) };
+
+    rc = bdm_cmd_raw(control, sizeof(control), 0, NULL);
+    if (rc == BDM_RC_OK)
+    {
+      rc = bdm_get_status(&status);
+    }
+    if ((rc == BDM_RC_OK) && ((status & HCS_BDCSCR_ENBDM) == 0))
+    {
+      return BDM_RC_BDM_EN_FAILED;
+    }
+  }
+
+  return rc;
 }
 
 //! HCS12/HCS08/RS08/CFV1 -  Set comm speed to user supplied value
 //!
 //! @note
 //!  command_buffer                                 \n
-//!  - [1..2] = 16-bit Sync value in 60MHz ticks
+//!  - [2..3] = 16-bit Sync value in 60MHz ticks
 //!
 //! @return
 //!    == \ref BDM_RC_OK => success        \n
 //!    != \ref BDM_RC_OK => error
 //!
+//! @note
+//!   The bdm-data clock follows the given speed, which is kept until the next connect.
+//!
 uint8_t _cmd_usbdm_set_speed(uint8_t* command_buffer)
 {
-  uint16_t sync_value = *(uint16_t*)(command_buffer+2); // Save the new speed
-  cable_status.sync_length = sync_value;
+  uint16_t sync_value = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+
+  if (sync_value == 0)
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  bdm_set_sync_length(sync_value);
+
+  cable_status.sync_length = sync_value;
   cable_status.speed       = SPEED_USER_SUPPLIED; // User told us (even if it doesn't work!)
+  cable_status.wait64_cnt  = bdm_get_wait_count(64);
+  cable_status.wait150_cnt = bdm_get_wait_count(150);
 
   return BDM_RC_OK;
 }
@@ -422,10 +997,27 @@ uint8_t _cmd_usbdm_read_status_reg(uint8_t* command_buffer)
   command_buffer[2] = 0;
   command_buffer[3] = 0;
 
+  if (is_run_until_armed && (run_until.mode == RUN_UNTIL_STEP))
+  {
+    // Stepped by the probe: halted between steps, but running for the host
+    uint8_t rc = bdm_cmd_read_status(command_buffer);
+    command_buffer[4] &= (uint8_t)~HCS_BDCSCR_BDMACT;
+    return rc;
+  }
+
+  if (is_halt_watch_armed)
+  {
+    // A conditional run may have to restart the target, and the halt event is due now
+    _poll_halt();
+  }
+
   // Save status on command_buffer[4]
-  bdm_cmd_read_status(command_buffer);
+  uint8_t rc = bdm_cmd_read_status(command_buffer);
 
-  return BDM_RC_OK;
+  // Memory and registers can only be cached while the target is seen halted
+  _set_halted((rc == BDM_RC_OK) && ((command_buffer[4] & HCS_BDCSCR_BDMACT) != 0));
+
+  return rc;
 }
 
 //! HCS12/HCS08/RS08/CFV1 -  Write Target BDM Control Register
@@ -440,9 +1032,7 @@ uint8_t _cmd_usbdm_read_status_reg(uint8_t* command_buffer)
 //!
 uint8_t _cmd_usbdm_write_control_reg(uint8_t* command_buffer)
 {
-  bdm_cmd_write_control(command_buffer);
-
-  return BDM_RC_OK;
+  return bdm_cmd_write_control(command_buffer);
 }
 
 //! HCS12/HCS08/RS08/CFV1 -  Reset Target
@@ -470,34 +1060,48 @@ uint8_t _cmd_usbdm_reset(uint8_t* command_buffer)
   case RESET_SOFTWARE:
   {
     // Soft reset HCS08
-    bdm_cmd_reset();
-    break;
+    uint8_t rc = bdm_cmd_reset();
+    _set_halted(false);
+    is_run_until_armed = false;
+    _arm_halt_watch(false);
+    cable_status.ackn = WAIT;
+
+    // The target restarts on its reset clock
+    if (cable_status.speed != SPEED_USER_SUPPLIED)
+    {
+      is_speed_stale = true;
+    }
+    return rc;
   }
   default:
   {
     return BDM_RC_ILLEGAL_PARAMS;
   }
   }
-
-  return BDM_RC_OK;
 }
 
 uint8_t _cmd_usbdm_step(uint8_t* command_buffer)
 {
-  bdm_cmd_trace();
-  return BDM_RC_OK;
+  is_run_until_armed = false;
+  uint8_t rc = bdm_cmd_trace();
+  _set_halted(false);
+  return rc;
 }
 
 uint8_t _cmd_usbdm_go(uint8_t* command_buffer)
 {
-  bdm_cmd_go();
-  return BDM_RC_OK;
+  is_run_until_armed = false;
+  uint8_t rc = bdm_cmd_go();
+  _set_halted(false);
+  _arm_halt_watch(rc == BDM_RC_OK);
+  return rc;
 }
 
 uint8_t _cmd_usbdm_halt(uint8_t* command_buffer)
 {
-  bdm_cmd_halt();
-  return BDM_RC_OK;
+  // The host stops a conditional run, the halt event still reports it
+  is_run_until_armed = false;
+  return bdm_cmd_halt();
 }
 
 
@@ -514,36 +1118,72 @@ uint8_t _cmd_usbdm_halt(uint8_t* command_buffer)
 //!
 uint8_t _cmd_usbdm_write_reg(uint8_t* command_buffer)
 {
+  uint8_t rc;
+
+  is_snapshot_valid = false;
 
   switch (command_buffer[3]) {
     case HCS08_RegPC :
         // 16 bit register
-        bdm_cmd_write_pc(command_buffer);
+        rc = bdm_cmd_write_pc(command_buffer);
         break;
     case HCS08_RegHX  :
         // 16 bit register
-        bdm_cmd_write_hx(command_buffer);
+        rc = bdm_cmd_write_hx(command_buffer);
         break;
     case HCS08_RegSP :
         // 16 bit register
-        bdm_cmd_write_sp(command_buffer);
+        rc = bdm_cmd_write_sp(command_buffer);
         break;
     case HCS08_RegA  :
         // 8 bit register
-        bdm_cmd_write_a(command_buffer);
+        rc = bdm_cmd_write_a(command_buffer);
         break;
     case HCS08_RegCCR :
         // 8 bit register
-        bdm_cmd_write_ccr(command_buffer);
+        rc = bdm_cmd_write_ccr(command_buffer);
         break;
     default:
         return BDM_RC_ILLEGAL_PARAMS;
   }
 
-  return BDM_RC_OK;
+  return rc;
 }
 
 
+// Serve CMD_USBDM_READ_REG from the register snapshot
+static uint8_t _read_reg_snapshot(uint8_t* command_buffer)
+{
+  uint8_t index;
+
+  switch (command_buffer[3]) {
+    case HCS08_RegA   : index = 0; break;
+    case HCS08_RegCCR : index = 1; break;
+    case HCS08_RegPC  : index = 2; break;
+    case HCS08_RegHX  : index = 4; break;
+    case HCS08_RegSP  : index = 6; break;
+    default:
+        return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  if (index < 2)
+  {
+    // 8 bit register
+    command_buffer[3] = 0;
+    command_buffer[4] = reg_snapshot[index];
+  }
+  else
+  {
+    // 16 bit register
+    command_buffer[3] = reg_snapshot[index];
+    command_buffer[4] = reg_snapshot[index+1];
+  }
+
+  response_size = 5;
+
+  return BDM_RC_OK;
+}
+
 //! RS08/HCS08 Read core register
 //!
 //! @note
@@ -562,26 +1202,33 @@ uint8_t _cmd_usbdm_read_reg(uint8_t* command_buffer)
   command_buffer[1] = 0;
   command_buffer[2] = 0;
 
+  if (is_snapshot_valid)
+  {
+    return _read_reg_snapshot(command_buffer);
+  }
+
+  uint8_t rc;
+
   switch (command_buffer[3]) {
     case HCS08_RegPC :
         // 16 bit register
-        bdm_cmd_read_pc(command_buffer);
+        rc = bdm_cmd_read_pc(command_buffer);
         break;
     case HCS08_RegHX  :
         // 16 bit register
-        bdm_cmd_read_hx(command_buffer);
+        rc = bdm_cmd_read_hx(command_buffer);
         break;
     case HCS08_RegSP :
         // 16 bit register
-        bdm_cmd_read_sp(command_buffer);
+        rc = bdm_cmd_read_sp(command_buffer);
         break;
     case HCS08_RegA  :
         // 8 bit register
-        bdm_cmd_read_a(command_buffer);
+        rc = bdm_cmd_read_a(command_buffer);
         break;
     case HCS08_RegCCR :
         // 8 bit register
-        bdm_cmd_read_ccr(command_buffer);
+        rc = bdm_cmd_read_ccr(command_buffer);
         break;
     default:
         return BDM_RC_ILLEGAL_PARAMS;
@@ -589,7 +1236,7 @@ uint8_t _cmd_usbdm_read_reg(uint8_t* command_buffer)
 
   response_size = 5;
 
-  return BDM_RC_OK;
+  return rc;
 }
 
 //! HCS08/RS08 Write to Breakpoint reg
@@ -608,9 +1255,7 @@ uint8_t _cmd_usbdm_write_bkpt(uint8_t* command_buffer)
   uint8_t addr_h = command_buffer[6];
   uint8_t addr_l = command_buffer[7];
 
-  bdm_cmd_write_bkpt(addr_h, addr_l);
-
-  return BDM_RC_OK;
+  return bdm_cmd_write_bkpt(addr_h, addr_l);
 }
 
 
@@ -634,11 +1279,74 @@ uint8_t _cmd_usbdm_read_bkpt(uint8_t* command_buffer)
   command_buffer[2] = 0;
 
   // Save 16 bit reg in command_buffer
-  bdm_cmd_read_bkpt(command_buffer+2);
+  return bdm_cmd_read_bkpt(command_buffer+2);
+}
 
-  return BDM_RC_OK;
+
+// Write memory, one burst per TARGET_MEM_CHUNK bytes. Stops at the first failed burst.
+static uint8_t _write_mem(uint8_t mode, uint16_t addr, uint16_t count, const uint8_t *data_ptr)
+{
+  uint8_t rc = BDM_RC_OK;
+
+  cache_invalidate_range(addr, count);
+
+  while ((count > 0) && (rc == BDM_RC_OK))
+  {
+    uint8_t chunk = (count > TARGET_MEM_CHUNK) ? TARGET_MEM_CHUNK : (uint8_t)count;
+
+    if (mode & MS_FAST)
+    {
+      // Stream the block with WRITE_NEXT
+      rc = bdm_cmd_write_block(addr, chunk, data_ptr);
+    }
+    else
+    {
+      // One WRITE_BYTE frame per byte, in a single burst
+      rc = bdm_cmd_write_bytes(addr, chunk, data_ptr);
+    }
+
+    addr     += chunk;
+    data_ptr += chunk;
+    count    -= chunk;
+  }
+
+  return rc;
 }
 
+// Read memory, one burst per TARGET_MEM_CHUNK bytes. Stops at the first failed burst.
+static uint8_t _read_mem(uint8_t mode, uint16_t addr, uint16_t count, uint8_t *data_ptr)
+{
+  uint8_t rc = BDM_RC_OK;
+
+  while ((count > 0) && (rc == BDM_RC_OK))
+  {
+    uint8_t chunk = (count > TARGET_MEM_CHUNK) ? TARGET_MEM_CHUNK : (uint8_t)count;
+    bool    is_cached;
+
+    rc = cache_read(addr, chunk, data_ptr, &is_cached);
+
+    if ((rc != BDM_RC_OK) || is_cached)
+    {
+      // Served by the cache, or failed
+    }
+    else if (mode & MS_FAST)
+    {
+      // Stream the block with READ_NEXT
+      rc = bdm_cmd_read_block(addr, chunk, data_ptr);
+    }
+    else
+    {
+      // One READ_BYTE frame per byte, in a single burst
+      rc = bdm_cmd_read_bytes(addr, chunk, data_ptr);
+    }
+
+    addr     += chunk;
+    data_ptr += chunk;
+    count    -= chunk;
+  }
+
+  return rc;
+}
 
 //! HCS08/RS08 -  Write block of bytes to memory
 //!
@@ -662,24 +1370,7 @@ uint8_t _cmd_usbdm_write_mem(uint8_t* command_buffer)
   uint16_t addr       = (uint16_t)((addr_h<<8) | addr_l);
   uint8_t *data_ptr   = command_buffer+8;
 
-  if (mode & MS_FAST)
-  {
-    // Not supported (yet)
-    return BDM_RC_FEATURE_NOT_SUPPORTED;
-  }
-  else
-  {
-    while (count > 0)
-    {
-      bdm_cmd_write_byte((uint8_t)(addr>>8), (uint8_t)(addr&0xFF), *data_ptr);
-
-      count--;        // decrement count of bytes
-      data_ptr++;     // increment buffer pointer
-      addr++;         // increment memory address
-    }
-  }
-
-  return BDM_RC_OK;
+  return _write_mem(mode, addr, count, data_ptr);
 }
 
 //! HCS08/RS08 -  Read block of data from memory
@@ -713,22 +1404,826 @@ uint8_t _cmd_usbdm_read_mem(uint8_t* command_buffer)
 
   response_size = count + 1;
 
-  if (mode & MS_FAST)
+  return _read_mem(mode, addr, count, data_ptr);
+}
+
+//! HCS08 -  Set up a programming stub in target RAM
+//!
+//! @note
+//!  command_buffer                                 \n
+//!  - [2..3]   = stub entry point                 \n
+//!  - [4..5]   = stack pointer                    \n
+//!  - [6..7]   = parameter block address (HX)     \n
+//!  - [8..11]  = page buffer addresses (2 x 16-bit) \n
+//!  - [12]     = page buffer size
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success
+//!
+//! @note
+//!   The stub itself is downloaded with CMD_USBDM_WRITE_MEM, see stub.h
+//!
+uint8_t _cmd_usbdm_stub_setup(uint8_t* command_buffer)
+{
+  uint16_t buffers[STUB_BUFFERS];
+
+  for (int i=0; i<STUB_BUFFERS; i++)
   {
-    // Not supported (yet)
-    return BDM_RC_FEATURE_NOT_SUPPORTED;
+    buffers[i] = (uint16_t)((command_buffer[8+2*i]<<8) | command_buffer[9+2*i]);
   }
-  else
+
+  stub_setup((uint16_t)((command_buffer[2]<<8) | command_buffer[3]),
+             (uint16_t)((command_buffer[4]<<8) | command_buffer[5]),
+             (uint16_t)((command_buffer[6]<<8) | command_buffer[7]),
+             buffers,
+             command_buffer[12]);
+
+  return BDM_RC_OK;
+}
+
+//! HCS08 -  Program a page with the stub
+//!
+//! @note
+//!  command_buffer                       \n
+//!  - [2..3] = flash address            \n
+//!  - [4]    = # of bytes               \n
+//!  - [5..N] = data to program
+//!
+//! @return
+//!    == \ref BDM_RC_OK => the page is being programmed  \n
+//!    != \ref BDM_RC_OK => error (previous page included)
+//!
+uint8_t _cmd_usbdm_stub_program(uint8_t* command_buffer)
+{
+  uint8_t  count = command_buffer[4];
+  uint16_t addr  = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+
+  if (count > command_length-5)
   {
-    while (count > 0)
-    {
-      bdm_cmd_read_byte((uint8_t)(addr>>8), (uint8_t)(addr&0xFF), data_ptr);
+    return BDM_RC_ILLEGAL_PARAMS; // data is missing
+  }
+
+  // The stub runs on the target
+  _set_halted(false);
+
+  return stub_program(addr, count, command_buffer+5);
+}
+
+//! HCS08 -  Wait for the last page programmed by the stub
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success           \n
+//!    != \ref BDM_RC_OK => error             \n
+//!                                           \n
+//!  command_buffer                            \n
+//!  - [1] = stub result code (0 = success)
+//!
+uint8_t _cmd_usbdm_stub_wait(uint8_t* command_buffer)
+{
+  uint8_t rc = stub_wait(command_buffer+1);
+
+  if (rc == BDM_RC_OK)
+  {
+    response_size = 2;
+  }
+
+  return rc;
+}
+
+//! HCS08 -  Set up the flash module
+//!
+//! @note
+//!  command_buffer                                            \n
+//!  - [2..3] = address of FCDIV (0 => default 0x1820)        \n
+//!  - [4]    = FCDIV value (0 => derived from the SYNC speed)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error
+//!
+uint8_t _cmd_usbdm_flash_setup(uint8_t* command_buffer)
+{
+  uint16_t base = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+
+  return flash_setup(base, command_buffer[4]);
+}
+
+//! HCS08 -  Erase or blank check flash
+//!
+//! @note
+//!  command_buffer                                  \n
+//!  - [2]    = mode, see \ref FlashEraseMode_t      \n
+//!  - [3..4] = address in the sector to erase
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error
+//!
+uint8_t _cmd_usbdm_flash_erase(uint8_t* command_buffer)
+{
+  uint16_t addr = (uint16_t)((command_buffer[3]<<8) | command_buffer[4]);
+
+  cache_invalidate();
+
+  return flash_erase((FlashEraseMode_t)command_buffer[2], addr);
+}
+
+//! HCS08 -  Program a block of flash
+//!
+//! @note
+//!  command_buffer                       \n
+//!  - [2..3] = address                  \n
+//!  - [4]    = # of bytes               \n
+//!  - [5..N] = data to program
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error
+//!
+uint8_t _cmd_usbdm_flash_program(uint8_t* command_buffer)
+{
+  uint8_t  count = command_buffer[4];
+  uint16_t addr  = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+
+  if (count > command_length-5)
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // data is missing
+  }
+
+  cache_invalidate_range(addr, count);
+
+  return flash_program(addr, count, command_buffer+5);
+}
+
+//! Configure the target memory cache
+//!
+//! @note
+//!  command_buffer                                              \n
+//!  - [2]      = 1 => enable the cache, 0 => disable it         \n
+//!  - [3]      = # of uncacheable regions (N, up to CACHE_REGIONS) \n
+//!  - [4..4N+3] = N x (16-bit first address, 16-bit last address)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error
+//!
+//! @note
+//!   Regions not given are disabled. By default the HCS08 registers
+//!   (0x0000-0x007F and 0x1800-0x18FF) are not cached.
+//!
+uint8_t _cmd_usbdm_cache_config(uint8_t* command_buffer)
+{
+  uint8_t region_count = command_buffer[3];
 
-      count--;        // decrement count of bytes
-      data_ptr++;     // increment buffer pointer
-      addr++;         // increment memory address
+  if ((region_count > CACHE_REGIONS) || (command_length < 4 + 4*region_count))
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  for (uint i=0; i<CACHE_REGIONS; i++)
+  {
+    uint8_t *region = command_buffer + 4 + 4*i;
+
+    if (i < region_count)
+    {
+      cache_set_region(i, (uint16_t)((region[0]<<8) | region[1]), (uint16_t)((region[2]<<8) | region[3]));
+    }
+    else
+    {
+      cache_set_region(i, 0xFFFF, 0x0000);
     }
   }
 
+  cache_set_enabled(command_buffer[2] != 0);
+
   return BDM_RC_OK;
-}
\ No newline at end of file
+}
+
+//! HCS08 Read all core registers
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success                         \n
+//!                                                         \n
+//!  command_buffer                                          \n
+//!  - [1]    => A                                          \n
+//!  - [2]    => CCR                                        \n
+//!  - [3..4] => PC                                         \n
+//!  - [5..6] => HX                                         \n
+//!  - [7..8] => SP
+//!
+//! @note
+//!   Served from the register snapshot when the target has been seen halted,
+//!   otherwise the registers are read now.
+//!
+uint8_t _cmd_usbdm_read_all_regs(uint8_t* command_buffer)
+{
+  uint8_t rc = BDM_RC_OK;
+
+  if (is_snapshot_valid)
+  {
+    memcpy(command_buffer+1, reg_snapshot, BDM_REGS_SIZE);
+  }
+  else
+  {
+    rc = bdm_cmd_read_regs(command_buffer+1);
+  }
+
+  response_size = BDM_REGS_SIZE + 1;
+
+  return rc;
+}
+
+//! Execute a BDM script on the probe
+//!
+//! @note
+//!  command_buffer                            \n
+//!  - [2..N] = script, see script.h
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success           \n
+//!    != \ref BDM_RC_OK => error             \n
+//!                                           \n
+//!  command_buffer                            \n
+//!  - [1..M] = results appended by the script
+//!
+uint8_t _cmd_usbdm_exec_script(uint8_t* command_buffer)
+{
+  // The script is read from command_buffer while results are collected
+  static uint8_t results[MAX_COMMAND_SIZE-1];
+  uint result_count;
+
+  if (command_length < 3)
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  // A script can run the target and write anything
+  _set_halted(false);
+
+  uint8_t rc = script_exec(command_buffer+2, command_length-2, results, sizeof(results), &result_count);
+
+  if (rc == BDM_RC_OK)
+  {
+    memcpy(command_buffer+1, results, result_count);
+    response_size = (uint8_t)(result_count + 1);
+  }
+
+  return rc;
+}
+
+//! HCS08 -  CRC32 of a target memory range
+//!
+//! @note
+//!  command_buffer                        \n
+//!  - [2..3] = address                   \n
+//!  - [4..5] = # of bytes
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error         \n
+//!                                       \n
+//!  command_buffer                        \n
+//!  - [1..4] = CRC32 (zlib)
+//!
+//! @note
+//!   The target must be halted (READ_NEXT), else BDM_RC_TARGET_BUSY
+//!
+uint8_t _cmd_usbdm_crc32_mem(uint8_t* command_buffer)
+{
+  uint16_t addr   = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+  uint32_t length = (uint32_t)((command_buffer[4]<<8) | command_buffer[5]);
+
+  if (addr + length > 0x10000)
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // range wraps around the address space
+  }
+
+  uint32_t crc;
+  uint8_t  rc = target_mem_crc32(addr, length, &crc);
+
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+
+  command_buffer[1] = (uint8_t)(crc>>24);
+  command_buffer[2] = (uint8_t)(crc>>16);
+  command_buffer[3] = (uint8_t)(crc>>8);
+  command_buffer[4] = (uint8_t)crc;
+  response_size = 5;
+
+  return BDM_RC_OK;
+}
+
+//! HCS08 -  Compare target memory against data
+//!
+//! @note
+//!  command_buffer                        \n
+//!  - [2..3] = address                   \n
+//!  - [4..5] = # of bytes (up to MAX_EXT_MEM_SIZE, extended framing beyond MAX_COMMAND_SIZE) \n
+//!  - [6..N] = expected data
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error         \n
+//!                                       \n
+//!  command_buffer                        \n
+//!  - [1]    = 0 => match, 1 => mismatch \n
+//!  - [2..3] = address of the first mismatch
+//!
+//! @note
+//!   The target must be halted (READ_NEXT), else BDM_RC_TARGET_BUSY
+//!
+uint8_t _cmd_usbdm_verify_mem(uint8_t* command_buffer)
+{
+  uint16_t addr  = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+  uint32_t count = (uint32_t)((command_buffer[4]<<8) | command_buffer[5]);
+  uint16_t mismatch_addr = 0;
+
+  if ((count > MAX_EXT_MEM_SIZE) || (6 + count > command_length))
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // data is missing
+  }
+  if (addr + count > 0x10000)
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // range wraps around the address space
+  }
+
+  bool    is_match;
+  uint8_t rc = target_mem_verify(addr, count, command_buffer+6, &is_match, &mismatch_addr);
+
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+
+  command_buffer[1] = is_match ? 0 : 1;
+  command_buffer[2] = (uint8_t)(mismatch_addr>>8);
+  command_buffer[3] = (uint8_t)mismatch_addr;
+  response_size = 4;
+
+  return BDM_RC_OK;
+}
+
+//! HCS08 -  Fill a target memory range with a pattern
+//!
+//! @note
+//!  command_buffer                                      \n
+//!  - [2..3] = address                                 \n
+//!  - [4..5] = # of bytes                              \n
+//!  - [6]    = 1 => read the range back, 0 => write only \n
+//!  - [7]    = pattern size (1 to TARGET_MEM_MAX_PATTERN) \n
+//!  - [8..N] = pattern
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error         \n
+//!                                       \n
+//!  command_buffer                        \n
+//!  - [1]    = 0 => filled, 1 => failed  \n
+//!  - [2..3] = address of the first failing byte
+//!
+//! @note
+//!   The target must be halted (WRITE_NEXT/READ_NEXT), else BDM_RC_TARGET_BUSY
+//!
+uint8_t _cmd_usbdm_fill_mem(uint8_t* command_buffer)
+{
+  uint16_t addr         = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+  uint32_t length       = (uint32_t)((command_buffer[4]<<8) | command_buffer[5]);
+  bool     verify       = command_buffer[6] != 0;
+  uint8_t  pattern_size = command_buffer[7];
+  uint16_t fail_addr    = 0;
+
+  if ((pattern_size == 0) || (pattern_size > TARGET_MEM_MAX_PATTERN) || (pattern_size > command_length-8))
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+  if (addr + length > 0x10000)
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // range wraps around the address space
+  }
+
+  cache_invalidate_range(addr, length);
+
+  bool    is_ok;
+  uint8_t rc = target_mem_fill(addr, length, command_buffer+8, pattern_size, verify, &is_ok, &fail_addr);
+
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+
+  command_buffer[1] = is_ok ? 0 : 1;
+  command_buffer[2] = (uint8_t)(fail_addr>>8);
+  command_buffer[3] = (uint8_t)fail_addr;
+  response_size = 4;
+
+  return BDM_RC_OK;
+}
+
+//! HCS08 -  Check that a target memory range is blank (0xFF)
+//!
+//! @note
+//!  command_buffer                        \n
+//!  - [2..3] = address                   \n
+//!  - [4..5] = # of bytes
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error         \n
+//!                                       \n
+//!  command_buffer                        \n
+//!  - [1]    = 0 => blank, 1 => not blank \n
+//!  - [2..3] = address of the first byte that isn't blank
+//!
+//! @note
+//!   The target must be halted (READ_NEXT), else BDM_RC_TARGET_BUSY
+//!
+uint8_t _cmd_usbdm_blank_check_mem(uint8_t* command_buffer)
+{
+  static const uint8_t blank = 0xFF;
+
+  uint16_t addr      = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+  uint32_t length    = (uint32_t)((command_buffer[4]<<8) | command_buffer[5]);
+  uint16_t fail_addr = 0;
+
+  if (addr + length > 0x10000)
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // range wraps around the address space
+  }
+
+  bool    is_blank;
+  uint8_t rc = target_mem_check_pattern(addr, length, &blank, 1, &is_blank, &fail_addr);
+
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+
+  command_buffer[1] = is_blank ? 0 : 1;
+  command_buffer[2] = (uint8_t)(fail_addr>>8);
+  command_buffer[3] = (uint8_t)fail_addr;
+  response_size = 4;
+
+  return BDM_RC_OK;
+}
+
+//! HCS08/RS08 -  Write a large block of bytes to memory (extended framing)
+//!
+//! @note
+//!  command_buffer                           \n
+//!  - [2]    = element size/mode            \n
+//!  - [3..4] = # of bytes (up to MAX_EXT_MEM_SIZE) \n
+//!  - [5..6] = address                      \n
+//!  - [7..N] = data to write
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error         \n
+//!
+uint8_t _cmd_usbdm_write_mem_ext(uint8_t* command_buffer)
+{
+  uint8_t  mode  = command_buffer[2];
+  uint16_t count = (uint16_t)((command_buffer[3]<<8) | command_buffer[4]);
+  uint16_t addr  = (uint16_t)((command_buffer[5]<<8) | command_buffer[6]);
+
+  if ((count > MAX_EXT_MEM_SIZE) || (7 + count > command_length))
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // data is missing
+  }
+
+  return _write_mem(mode, addr, count, command_buffer+7);
+}
+
+//! HCS08/RS08 -  Read a large block of memory (extended framing)
+//!
+//! @note
+//!  command_buffer                       \n
+//!  - [2]    = element size/mode        \n
+//!  - [3..4] = # of bytes (up to MAX_EXT_MEM_SIZE) \n
+//!  - [5..6] = address
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success      \n
+//!    != \ref BDM_RC_OK => error        \n
+//!                                      \n
+//!  commandBuffer                       \n
+//!  - [1..N]  = data read
+//!
+uint8_t _cmd_usbdm_read_mem_ext(uint8_t* command_buffer)
+{
+  uint8_t  mode  = command_buffer[2];
+  uint16_t count = (uint16_t)((command_buffer[3]<<8) | command_buffer[4]);
+  uint16_t addr  = (uint16_t)((command_buffer[5]<<8) | command_buffer[6]);
+
+  if (count > MAX_EXT_MEM_SIZE)
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // requested block + status is too long to fit into the buffer
+  }
+
+  response_size = count + 1;
+
+  return _read_mem(mode, addr, count, command_buffer+1);
+}
+
+//! Configure the halt event
+//!
+//! @note
+//!  command_buffer                                  \n
+//!  - [2..3] = BDCSCR poll interval in us, 0 => disabled
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success      \n
+//!    != \ref BDM_RC_OK => error
+//!
+//! @note
+//!   Once enabled, every CMD_USBDM_TARGET_GO starts polling BDCSCR between
+//!   commands. When the target enters background mode an \ref EVT_HALT event
+//!   is sent on the event interface, so the host does not have to poll
+//!   CMD_USBDM_READ_STATUS_REG.
+//!
+uint8_t _cmd_usbdm_halt_event(uint8_t* command_buffer)
+{
+  if (command_length < 4)
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  uint16_t interval_us = (uint16_t)((command_buffer[2]<<8) | command_buffer[3]);
+
+  if ((interval_us != 0) && (interval_us < HALT_POLL_MIN_US))
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  halt_poll_us = interval_us;
+
+  // Takes effect on the next GO, a conditional run keeps its own poll
+  if ((interval_us == 0) && !is_run_until_armed)
+  {
+    _arm_halt_watch(false);
+  }
+
+  return BDM_RC_OK;
+}
+
+//! Start or stop the live watch
+//!
+//! @note
+//!  command_buffer                                  \n
+//!  - [2..5] = sample period in us, 0 => stop      \n
+//!  - [6]    = # of ranges (N)                     \n
+//!  - [7..3N+6] = N x (16-bit address, 8-bit # of bytes)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success      \n
+//!    != \ref BDM_RC_OK => error
+//!
+//! @note
+//!   The ranges hold up to LIVE_WATCH_MAX_BYTES bytes in total. They are read with
+//!   READ_BYTE, which steals bus cycles without stopping the target.\n
+//!   Samples are streamed as \ref EVT_SAMPLE events on the event interface until stopped.
+//!   A refused request leaves the current live watch running.
+//!
+uint8_t _cmd_usbdm_live_watch(uint8_t* command_buffer)
+{
+  if (command_length < 7)
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  uint32_t period_us = ((uint32_t)command_buffer[2]<<24) | ((uint32_t)command_buffer[3]<<16) |
+                       ((uint32_t)command_buffer[4]<<8)  | command_buffer[5];
+  uint8_t  range_count = command_buffer[6];
+
+  if (period_us == 0)
+  {
+    is_live_watch_running = false;
+    _update_background();
+    return BDM_RC_OK;
+  }
+
+  if ((period_us < LIVE_WATCH_MIN_US) || (range_count == 0) || (command_length < 7 + 3*range_count))
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  // Build the list aside, a refused request leaves the running live watch untouched
+  uint16_t addr_list[LIVE_WATCH_MAX_BYTES];
+  uint     count = 0;
+
+  for (uint i=0; i<range_count; i++)
+  {
+    uint8_t *range = command_buffer + 7 + 3*i;
+    uint16_t addr  = (uint16_t)((range[0]<<8) | range[1]);
+
+    if (count + range[2] > LIVE_WATCH_MAX_BYTES)
+    {
+      return BDM_RC_ILLEGAL_PARAMS;
+    }
+
+    for (uint j=0; j<range[2]; j++)
+    {
+      addr_list[count++] = (uint16_t)(addr + j);
+    }
+  }
+
+  if (count == 0)
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  memcpy(live_watch_addr, addr_list, count*sizeof(addr_list[0]));
+  live_watch_count      = (uint8_t)count;
+  live_watch_period_us  = period_us;
+  next_live_sample      = get_absolute_time();
+  is_live_watch_running = true;
+  _update_background();
+
+  return BDM_RC_OK;
+}
+
+//! HCS08 Step N instructions and record the registers after each step
+//!
+//! @note
+//!  command_buffer                                  \n
+//!  - [2]    = options, see \ref TraceOptions_t     \n
+//!  - [3..4] = max # of steps                      \n
+//!  - [5..6] = first PC of the range (TRACE_PC_RANGE) \n
+//!  - [7..8] = last PC of the range (TRACE_PC_RANGE)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success      \n
+//!    != \ref BDM_RC_OK => error        \n
+//!                                      \n
+//!  command_buffer                       \n
+//!  - [1..2] = # of steps recorded (N)  \n
+//!  - [3]    = why the trace stopped, see \ref TraceStop_t \n
+//!  - [4..]  = N records: PC, or A, CCR, PC, HX, SP (TRACE_ALL_REGS)
+//!
+//! @note
+//!   Each step is a single burst (TRACE1 followed by the register reads), the
+//!   records are written straight into the response.
+//!   A BDM error stops the trace with TRACE_STOP_ERROR, the records of the steps
+//!   done are still returned with BDM_RC_OK.
+//!
+uint8_t _cmd_usbdm_trace(uint8_t* command_buffer)
+{
+  if (command_length < 9)
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  uint8_t  options   = command_buffer[2];
+  uint16_t max_steps = (uint16_t)((command_buffer[3]<<8) | command_buffer[4]);
+  uint16_t first_pc  = (uint16_t)((command_buffer[5]<<8) | command_buffer[6]);
+  uint16_t last_pc   = (uint16_t)((command_buffer[7]<<8) | command_buffer[8]);
+  bool     is_all    = (options & TRACE_ALL_REGS) != 0;
+  uint     record_size = is_all ? BDM_REGS_SIZE : 2;
+
+  if ((uint32_t)max_steps * record_size > MAX_EXT_COMMAND_SIZE - 4)
+  {
+    return BDM_RC_ILLEGAL_PARAMS; // trace is too long to fit into the buffer
+  }
+
+  _set_halted(false);
+
+  uint8_t *record_ptr = command_buffer + 4;
+  uint16_t steps      = 0;
+  uint8_t  reason     = TRACE_STOP_COUNT;
+
+  while (steps < max_steps)
+  {
+    uint8_t regs[1 + BDM_REGS_SIZE];
+
+    if (bdm_cmd_trace_regs(regs, is_all) != BDM_RC_OK)
+    {
+      reason = TRACE_STOP_ERROR;
+      break;
+    }
+    if ((regs[0] & HCS_BDCSCR_BDMACT) == 0)
+    {
+      reason = TRACE_STOP_RUNNING;
+      break;
+    }
+
+    if (is_all)
+    {
+      memcpy(record_ptr, regs + 1, BDM_REGS_SIZE);
+    }
+    else
+    {
+      record_ptr[0] = regs[3];
+      record_ptr[1] = regs[4];
+    }
+    record_ptr += record_size;
+    steps++;
+
+    uint16_t pc = (uint16_t)((regs[3]<<8) | regs[4]);
+    if ((options & TRACE_PC_RANGE) && ((pc < first_pc) || (pc > last_pc)))
+    {
+      reason = TRACE_STOP_PC_RANGE;
+      break;
+    }
+  }
+
+  if ((reason == TRACE_STOP_COUNT) || (reason == TRACE_STOP_PC_RANGE))
+  {
+    _set_halted(true);
+  }
+  else if (reason == TRACE_STOP_ERROR)
+  {
+    // Reported by TRACE_STOP_ERROR along with the steps done, not by the command status
+    bdm_take_error();
+    is_speed_stale = true;
+  }
+
+  command_buffer[1] = (uint8_t)(steps>>8);
+  command_buffer[2] = (uint8_t)steps;
+  command_buffer[3] = reason;
+  response_size     = 4 + steps*record_size;
+
+  return BDM_RC_OK;
+}
+
+//! HCS08 Run the target until a condition is met
+//!
+//! @note
+//!  command_buffer                                  \n
+//!  - [2]    = how the target runs, see \ref RunUntilMode_t \n
+//!  - [3]    = condition, see \ref RunUntilCondition_t \n
+//!  - [4..5] = parameter 1                         \n
+//!  - [6..7] = parameter 2
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success      \n
+//!    != \ref BDM_RC_OK => error
+//!
+//! @note
+//!   With RUN_UNTIL_GO the target runs to the breakpoint set by CMD_USBDM_WRITE_BKPT.
+//!   Each time it halts, the probe evaluates the condition and restarts it
+//!   while the condition is false. The first instruction is stepped before GO and the condition
+//!   is evaluated after it too (breakpoint hits only are counted by RUN_UNTIL_HIT_COUNT).
+//!   With RUN_UNTIL_STEP the condition is evaluated after every step.\n
+//!   Only the final halt is reported: by the halt event when enabled, and by
+//!   CMD_USBDM_READ_STATUS_REG. CMD_USBDM_TARGET_HALT cancels the run.
+//!
+uint8_t _cmd_usbdm_run_until(uint8_t* command_buffer)
+{
+  if (command_length < 8)
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  uint8_t mode      = command_buffer[2];
+  uint8_t condition = command_buffer[3];
+
+  if ((mode > RUN_UNTIL_STEP) || (condition > RUN_UNTIL_PC_OUTSIDE))
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  run_until.mode      = mode;
+  run_until.condition = condition;
+  run_until.param1    = (uint16_t)((command_buffer[4]<<8) | command_buffer[5]);
+  run_until.param2    = (uint16_t)((command_buffer[6]<<8) | command_buffer[7]);
+  run_until.hit_count = 0;
+  is_run_until_armed  = true;
+
+  uint8_t rc = BDM_RC_OK;
+
+  if (mode == RUN_UNTIL_GO)
+  {
+    // Step the instruction at PC (it may be the breakpoint) and check the condition
+    // on the registers after the step, as _poll_halt() does, before GO
+    rc = bdm_cmd_trace();
+    _set_halted(false);
+    if (rc == BDM_RC_OK)
+    {
+      _set_halted(true);
+      if (is_snapshot_valid && (condition != RUN_UNTIL_HIT_COUNT) &&
+          _is_run_until_met((uint16_t)((reg_snapshot[2]<<8) | reg_snapshot[3])))
+      {
+        // Already met: the target stays halted, the halt watch reports it as the final halt
+        is_run_until_armed = false;
+      }
+      else
+      {
+        rc = bdm_cmd_go();
+        _set_halted(false);
+      }
+    }
+  }
+  else
+  {
+    _set_halted(false);
+  }
+
+  if (rc != BDM_RC_OK)
+  {
+    is_run_until_armed = false;
+  }
+  _arm_halt_watch(rc == BDM_RC_OK);
+
+  return rc;
+}
@@ -55,6 +55,37 @@ typedef enum { /* type of reset action required */
 
 } TargetMode_t;
 
+//!  Options of CMD_USBDM_TRACE
+//!
+typedef enum {
+   TRACE_ALL_REGS    = (1<<0), //!< Record A, CCR, PC, HX, SP after each step, else only PC
+   TRACE_PC_RANGE    = (1<<1), //!< Stop after the step that leaves the PC range
+} TraceOptions_t;
+
+//!  Why CMD_USBDM_TRACE stopped
+//!
+typedef enum {
+   TRACE_STOP_COUNT       = 0, //!< Requested number of steps done
+   TRACE_STOP_PC_RANGE    = 1, //!< PC left the range (the last record is outside)
+   TRACE_STOP_RUNNING     = 2, //!< Target not back in background mode after a step (e.g. STOP/WAIT)
+   TRACE_STOP_ERROR       = 3, //!< BDM communication failed (no ACK)
+} TraceStop_t;
+
+//!  How the target runs for CMD_USBDM_RUN_UNTIL
+//!
+typedef enum {
+   RUN_UNTIL_GO           = 0, //!< Run to the hardware breakpoint, evaluate the condition at each hit
+   RUN_UNTIL_STEP         = 1, //!< Step, evaluate the condition after each step
+} RunUntilMode_t;
+
+//!  Condition of CMD_USBDM_RUN_UNTIL (parameter 1, parameter 2)
+//!
+typedef enum {
+   RUN_UNTIL_HIT_COUNT    = 0, //!< Stop at the Nth halt/step (N, -)
+   RUN_UNTIL_BYTE_EQUAL   = 1, //!< Stop when (byte & mask) == value (address, mask<<8 | value)
+   RUN_UNTIL_PC_OUTSIDE   = 2, //!< Stop when PC is outside the range (first PC, last PC)
+} RunUntilCondition_t;
+
 //--------------------------------------------------------------------+
 // IMPLEMENTED FUNCTIONALITIES
 //--------------------------------------------------------------------+
@@ -86,6 +117,32 @@ uint8_t _cmd_usbdm_read_bkpt(uint8_t* command_buffer);
 uint8_t _cmd_usbdm_write_mem(uint8_t* command_buffer);
 uint8_t _cmd_usbdm_read_mem(uint8_t* command_buffer);
 
+uint8_t _cmd_usbdm_stub_setup(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_stub_program(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_stub_wait(uint8_t* command_buffer);
+
+uint8_t _cmd_usbdm_flash_setup(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_flash_erase(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_flash_program(uint8_t* command_buffer);
+
+uint8_t _cmd_usbdm_cache_config(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_read_all_regs(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_exec_script(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_crc32_mem(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_verify_mem(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_fill_mem(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_blank_check_mem(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_write_mem_ext(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_read_mem_ext(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_halt_event(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_live_watch(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_trace(uint8_t* command_buffer);
+uint8_t _cmd_usbdm_run_until(uint8_t* command_buffer);
+
 // Processes all commands received over USB
-uint8_t command_exec(uint8_t* command_buffer);
+uint16_t command_exec(uint8_t* command_buffer, uint16_t command_size);
 void set_command_status(uint8_t status);
+
+// Background work on core 1 between commands
+extern volatile bool is_background_active;
+bool command_background_task(void);
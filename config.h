@@ -25,14 +25,27 @@
 // Final freq: 16MHZ
 // Test freq: 400Hz
 #define PIO_FREQ        16000000   //The default pio's clock speed in Hz
-// 2Mhz
-#define SYNC_FREQ       2000000   //The slowest possible BDC clock(normally the reference oscillator/64) in Hz
-#define SYNC_PERIOD     0.5       //in us
+#define SYNC_LOW_US     64        // SYNC low time: 128 cycles of the slowest possible BDC clock (2MHz, normally the reference oscillator/64)
+#define SYNC_TIMEOUT_US 10000     // Max time to wait for the start and for the end of the target SYNC response
+#define SYNC_AVERAGE    4         // Number of SYNC responses averaged for each speed measurement
+#define SYNC_OFFSET     3         // System clock cycles of the SYNC response not counted by bdm-sync.pio
+#define SYNC_MARGIN_US  100       // Extra time allowed to a SYNC before it is aborted
+
+#define ACK_TIMEOUT     0x3FFF    // Max loops of 2 BDC cycles to wait for an ACK pulse (14 bit)
+#define BURST_MARGIN_US 1000      // Extra time allowed to a burst (longest wire time) before it is aborted
 
 #define SYNC_COUNT_THRESHOLD    5   // Consecutive commands before a sync command should take place
 
 #define AUTO_SYNC   false
 
+#define STUB_TIMEOUT_US 100000    // Max time for a target RAM stub to program a page
+#define FLASH_TIMEOUT_US 500000   // Max time for a flash command to complete (mass erase included)
+
+#define HALT_POLL_MIN_US 100      // Shortest BDCSCR poll interval while waiting for the target to halt
+#define LIVE_WATCH_MIN_US 100     // Shortest live watch sample period
+#define RUN_UNTIL_STEP_CHUNK 64   // Steps of a conditional run between two commands
+#define LIVE_WATCH_MAX_BYTES 58   // Bytes in a live watch sample (EVENT_MAX_DATA less the time stamp)
+
 //--------------------------------------------------------------------+
 // USB CONFIG
 //--------------------------------------------------------------------+
@@ -46,6 +59,7 @@
 #define PRODUCT_DESCRIPTION         "USBDM ARM-SWD for OpenSDAv2.1"
 #define CONFIGURATION_DESCRIPTION   "Default configuration"
 #define BULK_INTERFACE_DESCRIPTION  "Bulk Interface"
+#define EVENT_INTERFACE_DESCRIPTION "Event Interface"
 #define CDC_INTERFACE_DESCRIPTION   "CDC Interface"               // 5: CDC Interface
 
 // Capabilities of the hardware - used to enable/disable appropriate code
@@ -76,4 +90,12 @@
 //! ICP version (2 hex digits, major.minor)
 #define ICP_VERSION_SW (2<<4|6) // 2.6
 
-#define MAX_COMMAND_SIZE       (254)
\ No newline at end of file
+#define MAX_COMMAND_SIZE       (254)
+
+//! Max size of a command or response using the extended framing
+#define MAX_EXT_COMMAND_SIZE   (4096+16)
+//! Max # of bytes of a memory command using the extended framing
+#define MAX_EXT_MEM_SIZE       (4096)
+
+//! Number of USB command buffers (a command is received while the previous one is executed)
+#define USBDM_COMMAND_SLOTS    (2)
\ No newline at end of file
@@ -0,0 +1,58 @@
+#include "event.h"
+
+#include "spsc_ring.h"
+
+// A record is owned by core 1 until posted, then by core 0 until released.
+// Records are used in ring order, so the ring can't hold more records than the pool.
+static event_t events[EVENT_QUEUE_SIZE];
+static void * volatile event_slots[EVENT_QUEUE_SIZE];
+static spsc_ring_t event_ring = SPSC_RING_INIT(event_slots);
+
+//! Get the next free record
+//!
+//! @return Record to fill, NULL if all the records are waiting to be sent (the event is lost)
+//!
+//! @note
+//!   The record is sent by \ref event_post
+//!
+event_t *event_alloc(void)
+{
+  if (spsc_ring_is_full(&event_ring))
+  {
+    return NULL;
+  }
+
+  return &events[event_ring.head & (EVENT_QUEUE_SIZE-1)];
+}
+
+//! Hand the record from \ref event_alloc over to core 0
+//!
+void event_post(void)
+{
+  spsc_ring_push(&event_ring, &events[event_ring.head & (EVENT_QUEUE_SIZE-1)]);
+}
+
+//! Get the oldest record waiting to be sent
+//!
+//! @return Record, NULL if none
+//!
+event_t *event_peek(void)
+{
+  event_t *event;
+
+  if (!spsc_ring_peek(&event_ring, (void**)&event))
+  {
+    return NULL;
+  }
+
+  return event;
+}
+
+//! Release the record from \ref event_peek once it has been written to the endpoint
+//!
+void event_release(void)
+{
+  event_t *event;
+
+  spsc_ring_pop(&event_ring, (void**)&event);
+}
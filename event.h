@@ -0,0 +1,35 @@
+#ifndef EVENT_H_
+#define EVENT_H_
+
+#include "pico/stdlib.h"
+
+//--------------------------------------------------------------------+
+// UNSOLICITED EVENTS
+//--------------------------------------------------------------------+
+// Records produced on core 1 (background tasks) and sent by core 0 on the
+// event interface. On the wire a record is [type][size][size bytes of data],
+// alone in its packet (see usbdm_event_task).
+//
+#define EVENT_MAX_DATA      (62)    // Record fits in a 64 byte packet
+#define EVENT_QUEUE_SIZE    (8)     // Records waiting to be sent (power of 2)
+
+typedef enum {
+   EVT_HALT          = 1,           //!< Target entered background mode
+   EVT_SAMPLE        = 2,           //!< Live watch sample
+} EventType_t;
+
+typedef struct {
+   uint8_t type;                    //!< See \ref EventType_t
+   uint8_t size;                    //!< Number of valid bytes in data
+   uint8_t data[EVENT_MAX_DATA];
+} event_t;
+
+// Producer (core 1)
+event_t *event_alloc(void);
+void event_post(void);
+
+// Consumer (core 0)
+event_t *event_peek(void);
+void event_release(void);
+
+#endif /* EVENT_H_ */
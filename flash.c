@@ -0,0 +1,265 @@
+#include "flash.h"
+
+#include "config.h"
+#include "BDM_options.h"
+
+#include "bdm.h"
+
+// Address of FCDIV in the target
+static uint16_t flash_base = HCS08_FLASH_BASE_DEFAULT;
+
+// Read FSTAT
+static uint8_t _read_fstat(uint8_t *value)
+{
+    uint16_t fstat = flash_base + FSTAT_OFFSET;
+
+    return bdm_cmd_read_byte((uint8_t)(fstat>>8), (uint8_t)fstat, value);
+}
+
+// Write a flash register
+static uint8_t _write_reg(uint offset, uint8_t value)
+{
+    uint16_t reg = flash_base + offset;
+
+    return bdm_cmd_write_byte((uint8_t)(reg>>8), (uint8_t)reg, value);
+}
+
+//! Wait until some FSTAT bits are set
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success                   \n
+//!    == \ref BDM_RC_FAIL => access error or protection violation \n
+//!    == \ref BDM_RC_FLASH_PROGRAMING_BUSY => timeout  \n
+//!    other => BDM error
+//!
+static uint8_t _wait_fstat(uint8_t mask, uint8_t *fstat)
+{
+    absolute_time_t timeout = make_timeout_time_us(FLASH_TIMEOUT_US);
+
+    do
+    {
+        uint8_t rc = _read_fstat(fstat);
+
+        if (rc != BDM_RC_OK)
+        {
+            return rc;
+        }
+
+        if (*fstat & (FSTAT_FPVIOL|FSTAT_FACCERR))
+        {
+            return BDM_RC_FAIL;
+        }
+        if ((*fstat & mask) == mask)
+        {
+            return BDM_RC_OK;
+        }
+    } while (!time_reached(timeout));
+
+    return BDM_RC_FLASH_PROGRAMING_BUSY;
+}
+
+//! Launch a flash command
+//!
+//! @param addr : flash address
+//! @param data : data to latch at the address
+//! @param fcmd : flash command
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => BDM error
+//!
+//! @note
+//!     Array write, FCMD write and launch are executed as a single burst.
+//!
+static uint8_t _launch(uint16_t addr, uint8_t data, uint8_t fcmd)
+{
+    const uint16_t addrs[3] = { addr, flash_base + FCMD_OFFSET, flash_base + FSTAT_OFFSET };
+    const uint8_t  data_seq[3] = { data, fcmd, FSTAT_FCBEF };
+
+    return bdm_cmd_write_scattered(addrs, data_seq, 3);
+}
+
+//! Flash clock divider for the measured target speed
+//!
+//! @param fcdiv : FCDIV value
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    == \ref BDM_RC_UNKNOWN_SPEED => speed unknown, BDC not clocked by the bus clock,
+//!                                    or no divider gives FCLK_MIN..FCLK_MAX \n
+//!    other => BDM error
+//!
+//! @note
+//!     The measured speed is the bus clock only when the BDC runs from it (BDCSCR.CLKSW = 1).
+//!
+static uint8_t _get_fcdiv(uint8_t *fcdiv)
+{
+    uint8_t status;
+    uint8_t rc = bdm_get_status(&status);
+
+    if (rc != BDM_RC_OK)
+    {
+        return rc;
+    }
+    if (!(status & HCS_BDCSCR_CLKSW))
+    {
+        // Alternate clock: the bus clock is not known
+        return BDM_RC_UNKNOWN_SPEED;
+    }
+
+    uint32_t bus_freq = bdm_get_bdc_freq();
+    uint8_t  prdiv8 = 0;
+
+    if (bus_freq == 0)
+    {
+        return BDM_RC_UNKNOWN_SPEED;
+    }
+
+    if (bus_freq > FCLK_PRDIV8_THRESHOLD)
+    {
+        prdiv8 = FCDIV_PRDIV8;
+        bus_freq /= 8;
+    }
+
+    // Smallest divider that keeps the flash clock below FCLK_MAX
+    uint32_t div = (bus_freq + FCLK_MAX - 1) / FCLK_MAX;
+
+    if (div == 0)
+    {
+        div = 1;
+    }
+    if ((div > FCDIV_DIV+1) || (bus_freq / div < FCLK_MIN))
+    {
+        return BDM_RC_UNKNOWN_SPEED;
+    }
+
+    *fcdiv = prdiv8 | (uint8_t)(div-1);
+
+    return BDM_RC_OK;
+}
+
+//! Set up the flash module
+//!
+//! @param base  : address of FCDIV (0 = HCS08_FLASH_BASE_DEFAULT)
+//! @param fcdiv : FCDIV value (0 = derived from the speed measured by SYNC)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success                \n
+//!    == \ref BDM_RC_UNKNOWN_SPEED => FCDIV can't be derived, see _get_fcdiv() \n
+//!    other => BDM error
+//!
+//! @note
+//!     FCDIV can only be written once after reset, it is left alone if already loaded.
+//!
+uint8_t flash_setup(uint16_t base, uint8_t fcdiv)
+{
+    flash_base = (base != 0) ? base : HCS08_FLASH_BASE_DEFAULT;
+
+    uint16_t fcdiv_addr = flash_base + FCDIV_OFFSET;
+    uint8_t  current;
+
+    uint8_t rc = bdm_cmd_read_byte((uint8_t)(fcdiv_addr>>8), (uint8_t)fcdiv_addr, &current);
+
+    if (rc != BDM_RC_OK)
+    {
+        return rc;
+    }
+
+    if (!(current & FCDIV_FDIVLD))
+    {
+        if (fcdiv == 0)
+        {
+            rc = _get_fcdiv(&fcdiv);
+            if (rc != BDM_RC_OK)
+            {
+                return rc;
+            }
+        }
+
+        rc = _write_reg(FCDIV_OFFSET, fcdiv);
+        if (rc != BDM_RC_OK)
+        {
+            return rc;
+        }
+    }
+
+    // Clear any previous error
+    return _write_reg(FSTAT_OFFSET, FSTAT_FPVIOL|FSTAT_FACCERR);
+}
+
+//! Erase (or blank check) the flash
+//!
+//! @param mode : see \ref FlashEraseMode_t
+//! @param addr : address in the sector to erase (any flash address for mass erase/blank check)
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success            \n
+//!    != \ref BDM_RC_OK => error (BDM_RC_FAIL if the array isn't blank)
+//!
+uint8_t flash_erase(FlashEraseMode_t mode, uint16_t addr)
+{
+    uint8_t fcmd;
+    uint8_t fstat;
+
+    switch (mode)
+    {
+        case FLASH_ERASE_SECTOR: fcmd = FCMD_SECTOR_ERASE; break;
+        case FLASH_ERASE_MASS:   fcmd = FCMD_MASS_ERASE;   break;
+        case FLASH_BLANK_CHECK:  fcmd = FCMD_BLANK_CHECK;  break;
+        default:
+            return BDM_RC_ILLEGAL_PARAMS;
+    }
+
+    uint8_t rc = _write_reg(FSTAT_OFFSET, FSTAT_FPVIOL|FSTAT_FACCERR);
+
+    if (rc == BDM_RC_OK)
+    {
+        rc = _launch(addr, 0xFF, fcmd);
+    }
+    if (rc == BDM_RC_OK)
+    {
+        rc = _wait_fstat(FSTAT_FCCF, &fstat);
+    }
+
+    if ((rc == BDM_RC_OK) && (mode == FLASH_BLANK_CHECK) && !(fstat & FSTAT_FBLANK))
+    {
+        return BDM_RC_FAIL;
+    }
+
+    return rc;
+}
+
+//! Program a block of flash with burst programming
+//!
+//! @param addr     : address of the first byte
+//! @param count    : # of bytes
+//! @param data_ptr : bytes to program
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error
+//!
+//! @note
+//!     The next byte is launched as soon as the command buffer is empty (FCBEF),
+//!     without waiting for the previous one to complete.
+//!
+uint8_t flash_program(uint16_t addr, uint8_t count, const uint8_t *data_ptr)
+{
+    uint8_t fstat;
+    uint8_t rc = _write_reg(FSTAT_OFFSET, FSTAT_FPVIOL|FSTAT_FACCERR);
+
+    for (int i=0; (i<count) && (rc == BDM_RC_OK); i++)
+    {
+        rc = _wait_fstat(FSTAT_FCBEF, &fstat);
+        if (rc == BDM_RC_OK)
+        {
+            rc = _launch((uint16_t)(addr+i), data_ptr[i], FCMD_BURST_PROGRAM);
+        }
+    }
+    if (rc != BDM_RC_OK)
+    {
+        return rc;
+    }
+
+    return _wait_fstat(FSTAT_FCCF, &fstat);
+}
@@ -0,0 +1,53 @@
+#ifndef FLASH_H_
+#define FLASH_H_
+
+#include "pico/stdlib.h"
+
+//--------------------------------------------------------------------+
+// HCS08 FLASH
+//--------------------------------------------------------------------+
+// Flash module registers (offset from the register base)
+#define HCS08_FLASH_BASE_DEFAULT  (0x1820)  //!< Default address of FCDIV
+#define FCDIV_OFFSET    0
+#define FCNFG_OFFSET    3
+#define FPROT_OFFSET    4
+#define FSTAT_OFFSET    5
+#define FCMD_OFFSET     6
+
+// FCDIV bit masks
+#define FCDIV_FDIVLD    (0x80)  //!< FCDIV has been written since reset
+#define FCDIV_PRDIV8    (0x40)  //!< Prescale the bus clock by 8
+#define FCDIV_DIV       (0x3F)  //!< Divider - 1
+
+// FSTAT bit masks
+#define FSTAT_FCBEF     (0x80)  //!< Command buffer empty (write 1 to launch a command)
+#define FSTAT_FCCF      (0x40)  //!< Command complete
+#define FSTAT_FPVIOL    (0x20)  //!< Protection violation
+#define FSTAT_FACCERR   (0x10)  //!< Access error
+#define FSTAT_FBLANK    (0x04)  //!< Blank check passed
+
+// FCMD commands
+#define FCMD_BLANK_CHECK    (0x05)
+#define FCMD_BYTE_PROGRAM   (0x20)
+#define FCMD_BURST_PROGRAM  (0x25)
+#define FCMD_SECTOR_ERASE   (0x40)
+#define FCMD_MASS_ERASE     (0x41)
+
+// Flash clock range (Hz)
+#define FCLK_MIN        150000
+#define FCLK_MAX        200000
+// Bus clock above which PRDIV8 is needed (DIV is only 6 bit)
+#define FCLK_PRDIV8_THRESHOLD   12800000
+
+//! Erase modes for \ref flash_erase
+typedef enum {
+   FLASH_ERASE_SECTOR  = 0,   //!< Erase the sector holding the address
+   FLASH_ERASE_MASS    = 1,   //!< Erase the whole array
+   FLASH_BLANK_CHECK   = 2,   //!< Only check that the whole array is blank
+} FlashEraseMode_t;
+
+uint8_t flash_setup(uint16_t base, uint8_t fcdiv);
+uint8_t flash_erase(FlashEraseMode_t mode, uint16_t addr);
+uint8_t flash_program(uint16_t addr, uint8_t count, const uint8_t *data_ptr);
+
+#endif /* FLASH_H_ */
@@ -0,0 +1,240 @@
+// Command throughput of the firmware against the simulated HCS08 target
+//
+// Every command goes through command_exec() like it does on core 1, the time is the simulated
+// time of the RP2040 (PIO, DMA and the CPU polls). For each command type the benchmark reports
+// commands/s and bytes/s, and checks the data against the target memory and registers.
+//
+// At the default BDC clock the memory commands must not take more BDC cycles per byte than
+// they did (see the limits below): any increase of the wire time per byte fails the benchmark.
+//
+// Usage: bdm_bench [BDC clock in MHz, default 8]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "config.h"
+#include "bdm.h"
+#include "cmd_proc.h"
+#include "sim.h"
+#include "hcs08_target.h"
+
+#define BENCH_RUNS      64      // Commands of each type
+#define BENCH_BLOCK     128     // Bytes of a memory command
+#define BENCH_ADDR      0x0100  // Start of the memory used by the benchmark
+#define BENCH_BDC_HZ    (8*MHZ) // Default BDC clock, the one of the limits
+
+// Max BDC cycles per byte at BENCH_BDC_HZ. Lower them when the firmware gets faster.
+#define READ_FAST_MAX_CYCLES    309     // READ_MEM MS_FAST, BENCH_BLOCK bytes
+#define READ_BYTE_MAX_CYCLES    555     // READ_MEM byte mode, BENCH_BLOCK bytes
+#define READ_ONE_MAX_CYCLES     1579    // READ_MEM of a single byte
+#define WRITE_FAST_MAX_CYCLES   310     // WRITE_MEM MS_FAST, BENCH_BLOCK bytes
+#define WRITE_BYTE_MAX_CYCLES   556     // WRITE_MEM byte mode, BENCH_BLOCK bytes
+#define WRITE_ONE_MAX_CYCLES    1580    // WRITE_MEM of a single byte
+
+static uint8_t buffer[MAX_COMMAND_SIZE + 8];
+static uint32_t bdc_hz;
+static int failures = 0;
+
+static void _fail(const char *name, const char *what)
+{
+    printf("FAIL %s: %s\n", name, what);
+    failures++;
+}
+
+// Execute one command, return its status
+static uint8_t _exec(uint16_t size)
+{
+    command_exec(buffer, size);
+
+    return buffer[0];
+}
+
+// Print the throughput, check the BDC cycles per byte against max_cycles (0: no limit)
+static void _report(const char *name, uint runs, uint bytes, sim_time_t start, uint max_cycles)
+{
+    double seconds = (double)(sim_now - start) / ((double)sim_sys_hz() * SIM_TICKS_PER_CYCLE);
+
+    printf("%-22s %10.0f commands/s %12.0f bytes/s %10.2f us/command",
+           name, runs / seconds, bytes / seconds, 1e6 * seconds / runs);
+
+    if (bytes == 0)
+    {
+        printf("\n");
+        return;
+    }
+
+    double cycles = seconds * bdc_hz / bytes;
+
+    printf(" %8.1f cycles/byte\n", cycles);
+
+    if ((max_cycles > 0) && (bdc_hz == BENCH_BDC_HZ) && (cycles > max_cycles))
+    {
+        printf("FAIL %s: %.1f BDC cycles per byte, was %u\n", name, cycles, max_cycles);
+        failures++;
+    }
+}
+
+static void _bench_connect(void)
+{
+    const char *name = "CONNECT (SYNC)";
+    sim_time_t start = sim_now;
+    uint syncs = hcs08.sync_count;
+
+    for (uint i = 0; i < BENCH_RUNS; i++)
+    {
+        buffer[1] = CMD_USBDM_CONNECT;
+        if (_exec(2) != BDM_RC_OK)
+        {
+            _fail(name, "connect failed");
+            return;
+        }
+    }
+    _report(name, BENCH_RUNS, 0, start, 0);
+
+    if (hcs08.sync_count == syncs)
+    {
+        _fail(name, "no SYNC seen by the target");
+    }
+}
+
+static void _bench_read_mem(const char *name, uint8_t mode, uint count, uint max_cycles)
+{
+    sim_time_t start = sim_now;
+    uint16_t addr = BENCH_ADDR;
+
+    for (uint i = 0; i < BENCH_RUNS; i++, addr += count)
+    {
+        memset(buffer, 0, sizeof(buffer));
+        buffer[1] = CMD_USBDM_READ_MEM;
+        buffer[2] = mode;
+        buffer[3] = (uint8_t)count;
+        buffer[6] = (uint8_t)(addr >> 8);
+        buffer[7] = (uint8_t)addr;
+
+        if (_exec(8) != BDM_RC_OK)
+        {
+            _fail(name, "command failed");
+            return;
+        }
+        if (memcmp(&buffer[1], &hcs08.memory[addr], count) != 0)
+        {
+            _fail(name, "data differ from the target memory");
+            return;
+        }
+    }
+    _report(name, BENCH_RUNS, BENCH_RUNS*count, start, max_cycles);
+}
+
+static void _bench_write_mem(const char *name, uint8_t mode, uint count, uint max_cycles)
+{
+    sim_time_t start = sim_now;
+    uint16_t addr = BENCH_ADDR;
+
+    for (uint i = 0; i < BENCH_RUNS; i++, addr += count)
+    {
+        buffer[1] = CMD_USBDM_WRITE_MEM;
+        buffer[2] = mode;
+        buffer[3] = (uint8_t)count;
+        buffer[6] = (uint8_t)(addr >> 8);
+        buffer[7] = (uint8_t)addr;
+        for (uint j = 0; j < count; j++)
+        {
+            buffer[8 + j] = (uint8_t)(~hcs08_pattern(addr + j) + i);
+        }
+
+        if (_exec((uint16_t)(8 + count)) != BDM_RC_OK)
+        {
+            _fail(name, "command failed");
+            return;
+        }
+        if (memcmp(&buffer[8], &hcs08.memory[addr], count) != 0)
+        {
+            _fail(name, "target memory differs from the data written");
+            return;
+        }
+    }
+    _report(name, BENCH_RUNS, BENCH_RUNS*count, start, max_cycles);
+}
+
+// WRITE_REG then READ_REG of PC (the write drops the register snapshot, the read goes to the target)
+static void _bench_registers(void)
+{
+    const char *name = "WRITE_REG + READ_REG";
+    sim_time_t start = sim_now;
+
+    for (uint i = 0; i < BENCH_RUNS; i++)
+    {
+        uint16_t pc = (uint16_t)(0x8000 + 3*i);
+
+        memset(buffer, 0, sizeof(buffer));
+        buffer[1] = CMD_USBDM_WRITE_REG;
+        buffer[3] = HCS08_RegPC;
+        buffer[6] = (uint8_t)(pc >> 8);
+        buffer[7] = (uint8_t)pc;
+        if (_exec(8) != BDM_RC_OK)
+        {
+            _fail(name, "write failed");
+            return;
+        }
+
+        memset(buffer, 0, sizeof(buffer));
+        buffer[1] = CMD_USBDM_READ_REG;
+        buffer[3] = HCS08_RegPC;
+        if (_exec(4) != BDM_RC_OK)
+        {
+            _fail(name, "read failed");
+            return;
+        }
+        if ((hcs08.pc != pc) || (buffer[3] != (uint8_t)(pc >> 8)) || (buffer[4] != (uint8_t)pc))
+        {
+            _fail(name, "register value differs");
+            return;
+        }
+    }
+    // Two commands, 2 bytes each way
+    _report(name, 2*BENCH_RUNS, 4*BENCH_RUNS, start, 0);
+}
+
+int main(int argc, char **argv)
+{
+    bdc_hz = (argc > 1) ? (uint32_t)(atof(argv[1]) * MHZ) : BENCH_BDC_HZ;
+
+    // Same start as main(): sys clock, then the PIO programs
+    set_sys_clock_pll(VCO_FREQ * MHZ, POST_DEV1, POST_DEV2);
+    sim_reset(clock_get_hz(clk_sys));
+    hcs08_init(bdc_hz);
+    bdm_pio_init();
+
+    printf("sys clock %u MHz, BDC clock %.3f MHz\n", sim_sys_hz() / MHZ, (double)bdc_hz / MHZ);
+
+    buffer[1] = CMD_USBDM_CONNECT;
+    if (_exec(2) != BDM_RC_OK)
+    {
+        printf("FAIL connect\n");
+        return EXIT_FAILURE;
+    }
+
+    _bench_connect();
+    _bench_read_mem("READ_MEM fast", MS_FAST | MS_Byte, BENCH_BLOCK, READ_FAST_MAX_CYCLES);
+    _bench_read_mem("READ_MEM byte", MS_Byte, BENCH_BLOCK, READ_BYTE_MAX_CYCLES);
+    _bench_read_mem("READ_MEM 1 byte", MS_FAST | MS_Byte, 1, READ_ONE_MAX_CYCLES);
+    _bench_write_mem("WRITE_MEM fast", MS_FAST | MS_Byte, BENCH_BLOCK, WRITE_FAST_MAX_CYCLES);
+    _bench_write_mem("WRITE_MEM byte", MS_Byte, BENCH_BLOCK, WRITE_BYTE_MAX_CYCLES);
+    _bench_write_mem("WRITE_MEM 1 byte", MS_FAST | MS_Byte, 1, WRITE_ONE_MAX_CYCLES);
+    _bench_registers();
+
+    printf("target: %u commands, %u SYNC, %u ACK, %u ignored, %u protocol errors\n",
+           hcs08.command_count, hcs08.sync_count, hcs08.ack_count, hcs08.ignored_count,
+           hcs08.protocol_errors);
+
+    if (hcs08.protocol_errors != 0)
+    {
+        _fail("target", "protocol errors");
+    }
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,398 @@
+// Simulated HCS08 target, see hcs08_target.h
+
+#include <string.h>
+
+#include "hcs08_target.h"
+
+#include "bdm.h"
+
+// BDCSCR bits
+#define BDCSCR_ENBDM    (0x80)
+#define BDCSCR_BDMACT   (0x40)
+#define BDCSCR_BKPTEN   (0x20)
+#define BDCSCR_FTS      (0x10)
+#define BDCSCR_CLKSW    (0x08)
+#define BDCSCR_WRITABLE (BDCSCR_ENBDM | BDCSCR_BKPTEN | BDCSCR_FTS | BDCSCR_CLKSW)
+
+// System background debug force reset register
+#define SBDFR_ADDR      (0x1801)
+#define SBDFR_BDFR      (0x01)
+
+// Max number of scheduled low pulses of the target
+#define MAX_DRIVES      4
+
+hcs08_t hcs08;
+
+typedef struct {
+    uint8_t code;
+    uint8_t param_bytes;    // bytes after the command code
+    uint8_t reply_bytes;    // bytes sent by the target
+    bool    is_active_only; // active background mode command
+    bool    is_no_delay;    // no delay, no ACK
+} bdc_command_t;
+
+static const bdc_command_t commands[] = {
+    { BACKGROUND,    0, 0, false, false },
+    { ACK_ENABLE,    0, 0, false, false },
+    { ACK_DISABLED,  0, 0, false, false },
+    { READ_STATUS,   0, 1, false, true  },
+    { WRITE_CONTROL, 1, 0, false, true  },
+    { READ_BYTE,     2, 1, false, false },
+    { READ_BYTE_WS,  2, 2, false, false },
+    { READ_LAST,     0, 2, false, false },
+    { WRITE_BYTE,    3, 0, false, false },
+    { WRITE_BYTE_WS, 3, 1, false, false },
+    { READ_BKPT,     0, 2, false, true  },
+    { WRITE_BKPT,    2, 0, false, true  },
+    { GO,            0, 0, true,  false },
+    { TRACE1,        0, 0, true,  false },
+    { TAGGO,         0, 0, true,  false },
+    { READ_A,        0, 1, true,  false },
+    { READ_CCR,      0, 1, true,  false },
+    { READ_PC,       0, 2, true,  false },
+    { READ_HX,       0, 2, true,  false },
+    { READ_SP,       0, 2, true,  false },
+    { READ_NEXT,     0, 1, true,  false },
+    { READ_NEXT_WS,  0, 2, true,  false },
+    { WRITE_A,       1, 0, true,  false },
+    { WRITE_CCR,     1, 0, true,  false },
+    { WRITE_PC,      2, 0, true,  false },
+    { WRITE_HX,      2, 0, true,  false },
+    { WRITE_SP,      2, 0, true,  false },
+    { WRITE_NEXT,    1, 0, true,  false },
+    { WRITE_NEXT_WS, 1, 1, true,  false },
+};
+
+// Decoder
+static sim_time_t           cycle_ticks;
+static sim_time_t           fall_time;          // last host falling edge
+static uint32_t             shift;              // bits received
+static uint                 bit_count;
+static const bdc_command_t *command;            // NULL until the command code is received
+static bool                 is_replying;
+static bool                 is_reply_pulse;     // the host low pulse asks for a reply bit
+static uint32_t             reply;              // bits to send, left aligned
+static uint                 reply_bits;
+static sim_time_t           ready_time;         // first bit of the reply not before
+static sim_time_t           run_start;          // GO time
+
+// Low pulses scheduled by the target
+static struct {
+    sim_time_t start;
+    sim_time_t end;
+} drives[MAX_DRIVES];
+static uint drive_count;
+
+void hcs08_init(uint32_t bdc_hz)
+{
+    memset(&hcs08, 0, sizeof(hcs08));
+
+    for (uint32_t addr = 0; addr < sizeof(hcs08.memory); addr++)
+    {
+        hcs08.memory[addr] = hcs08_pattern(addr);
+    }
+
+    hcs08.a = 0x12;
+    hcs08.ccr = 0x60;
+    hcs08.pc = 0x8000;
+    hcs08.hx = 0x0080;
+    hcs08.sp = 0x00FF;
+    hcs08.bdcscr = BDCSCR_ENBDM | BDCSCR_BDMACT | BDCSCR_CLKSW;
+    hcs08.bdc_hz = bdc_hz;
+
+    cycle_ticks = ((sim_time_t)sim_sys_hz() * SIM_TICKS_PER_CYCLE + bdc_hz/2) / bdc_hz;
+    command = NULL;
+    bit_count = 0;
+    is_replying = false;
+    drive_count = 0;
+}
+
+sim_time_t hcs08_cycle_ticks(void)
+{
+    return cycle_ticks;
+}
+
+static void _drive_low(sim_time_t start, sim_time_t end)
+{
+    // Forget the pulses that are over
+    uint kept = 0;
+
+    for (uint i = 0; i < drive_count; i++)
+    {
+        if (drives[i].end > start)
+        {
+            drives[kept++] = drives[i];
+        }
+    }
+    drive_count = kept;
+
+    if (drive_count < MAX_DRIVES)
+    {
+        drives[drive_count].start = start;
+        drives[drive_count].end = end;
+        drive_count++;
+    }
+}
+
+bool hcs08_drives_low(sim_time_t t)
+{
+    if (hcs08.is_disconnected)
+    {
+        return false;
+    }
+
+    for (uint i = 0; i < drive_count; i++)
+    {
+        if ((t >= drives[i].start) && (t < drives[i].end))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void _idle(void)
+{
+    command = NULL;
+    bit_count = 0;
+    shift = 0;
+    is_replying = false;
+}
+
+// The CPU runs until the breakpoint, if enabled
+static void _update_run(sim_time_t t)
+{
+    if (hcs08.is_running && (hcs08.bdcscr & BDCSCR_BKPTEN) && (t >= run_start + HCS08_RUN_CYCLES*cycle_ticks))
+    {
+        hcs08.is_running = false;
+        hcs08.pc = hcs08.bkpt;
+        hcs08.bdcscr |= BDCSCR_BDMACT;
+    }
+}
+
+static void _reset(bool is_active)
+{
+    hcs08.is_ack_enabled = false;
+    hcs08.is_running = !is_active;
+    hcs08.pc = (uint16_t)((hcs08.memory[0xFFFE] << 8) | hcs08.memory[0xFFFF]);
+    hcs08.sp = 0x00FF;
+    hcs08.bdcscr &= (uint8_t)~BDCSCR_BDMACT;
+    if (is_active)
+    {
+        hcs08.bdcscr |= BDCSCR_ENBDM | BDCSCR_BDMACT;
+    }
+}
+
+static uint8_t _read(uint16_t addr)
+{
+    hcs08.last_data = hcs08.memory[addr];
+
+    return hcs08.last_data;
+}
+
+static void _write(uint16_t addr, uint8_t data)
+{
+    hcs08.last_data = data;
+
+    if ((addr == SBDFR_ADDR) && (data & SBDFR_BDFR))
+    {
+        // BDC forced reset, BKGD is high: the target runs
+        _reset(false);
+        return;
+    }
+    hcs08.memory[addr] = data;
+}
+
+// Execute the command, its last bit started at last_fall
+static void _execute(sim_time_t last_fall)
+{
+    sim_time_t end = last_fall + HCS08_BIT_CYCLES*cycle_ticks;
+    uint8_t    code = command->code;
+    uint16_t   param16 = (uint16_t)shift;
+    uint8_t    param8 = (uint8_t)shift;
+    uint32_t   data = 0;
+    bool       is_ack = hcs08.is_ack_enabled && !command->is_no_delay;
+
+    _update_run(last_fall);
+
+    if (command->is_active_only && !(hcs08.bdcscr & BDCSCR_BDMACT))
+    {
+        // Ignored: nothing is sent back, no ACK
+        hcs08.ignored_count++;
+        _idle();
+        return;
+    }
+
+    hcs08.command_count++;
+
+    switch (code)
+    {
+        case BACKGROUND:
+            if (hcs08.bdcscr & BDCSCR_ENBDM)
+            {
+                hcs08.is_running = false;
+                hcs08.bdcscr |= BDCSCR_BDMACT;
+            }
+            break;
+        case ACK_ENABLE:
+            hcs08.is_ack_enabled = true;
+            is_ack = true;
+            break;
+        case ACK_DISABLED:
+            hcs08.is_ack_enabled = false;
+            is_ack = false;
+            break;
+        case READ_STATUS:   data = hcs08.bdcscr; break;
+        case WRITE_CONTROL:
+            hcs08.bdcscr = (uint8_t)((hcs08.bdcscr & ~BDCSCR_WRITABLE) | (param8 & BDCSCR_WRITABLE));
+            break;
+        case READ_BYTE:     data = _read(param16); break;
+        case READ_BYTE_WS:  data = ((uint32_t)hcs08.bdcscr << 8) | _read(param16); break;
+        case READ_LAST:     data = ((uint32_t)hcs08.bdcscr << 8) | hcs08.last_data; break;
+        case WRITE_BYTE:    _write((uint16_t)(shift >> 8), param8); break;
+        case WRITE_BYTE_WS: _write((uint16_t)(shift >> 8), param8); data = hcs08.bdcscr; break;
+        case READ_BKPT:     data = hcs08.bkpt; break;
+        case WRITE_BKPT:    hcs08.bkpt = param16; break;
+        case GO:
+        case TAGGO:
+            hcs08.is_running = true;
+            hcs08.bdcscr &= (uint8_t)~BDCSCR_BDMACT;
+            run_start = end;
+            break;
+        case TRACE1:        hcs08.pc++; break;
+        case READ_A:        data = hcs08.a; break;
+        case READ_CCR:      data = hcs08.ccr; break;
+        case READ_PC:       data = hcs08.pc; break;
+        case READ_HX:       data = hcs08.hx; break;
+        case READ_SP:       data = hcs08.sp; break;
+        case READ_NEXT:     data = _read(++hcs08.hx); break;
+        case READ_NEXT_WS:  data = ((uint32_t)hcs08.bdcscr << 8) | _read(++hcs08.hx); break;
+        case WRITE_A:       hcs08.a = param8; break;
+        case WRITE_CCR:     hcs08.ccr = param8; break;
+        case WRITE_PC:      hcs08.pc = param16; break;
+        case WRITE_HX:      hcs08.hx = param16; break;
+        case WRITE_SP:      hcs08.sp = param16; break;
+        case WRITE_NEXT:    _write(++hcs08.hx, param8); break;
+        case WRITE_NEXT_WS: _write(++hcs08.hx, param8); data = hcs08.bdcscr; break;
+        default:            break;
+    }
+
+    if (is_ack)
+    {
+        sim_time_t ack_start = end + HCS08_ACK_START_CYCLES*cycle_ticks;
+
+        _drive_low(ack_start, ack_start + HCS08_ACK_PULSE_CYCLES*cycle_ticks);
+        hcs08.ack_count++;
+        ready_time = ack_start + HCS08_ACK_PULSE_CYCLES*cycle_ticks;
+    }
+    else
+    {
+        ready_time = end + (command->is_no_delay ? 0 : HCS08_DELAY_CYCLES*cycle_ticks);
+    }
+
+    reply_bits = 8u*command->reply_bytes;
+    reply = (reply_bits > 0) ? data << (32 - reply_bits) : 0;
+
+    command = NULL;
+    bit_count = 0;
+    shift = 0;
+    is_replying = (reply_bits > 0);
+}
+
+// A bit from the host, its falling edge was at fall
+static void _receive_bit(bool bit, sim_time_t fall)
+{
+    shift = (shift << 1) | (bit ? 1u : 0u);
+    bit_count++;
+
+    if ((command == NULL) && (bit_count == 8))
+    {
+        for (uint i = 0; i < count_of(commands); i++)
+        {
+            if (commands[i].code == (uint8_t)shift)
+            {
+                command = &commands[i];
+            }
+        }
+        if (command == NULL)
+        {
+            hcs08.protocol_errors++;
+            _idle();
+            return;
+        }
+        shift = 0;
+        bit_count = 0;
+    }
+
+    if ((command != NULL) && (bit_count == 8u*command->param_bytes))
+    {
+        _execute(fall);
+    }
+}
+
+// The host asks for the next bit of the reply
+static void _send_bit(sim_time_t fall)
+{
+    if (fall < ready_time)
+    {
+        // Too early: the real target may not be ready
+        hcs08.protocol_errors++;
+    }
+
+    if (!(reply & 0x80000000u))
+    {
+        _drive_low(fall, fall + HCS08_ZERO_CYCLES*cycle_ticks);
+    }
+    reply <<= 1;
+
+    if (--reply_bits == 0)
+    {
+        is_replying = false;
+    }
+}
+
+void hcs08_host_edge(sim_time_t t, bool level)
+{
+    if (hcs08.is_disconnected)
+    {
+        return;
+    }
+
+    if (!level)
+    {
+        fall_time = t;
+        is_reply_pulse = is_replying;
+
+        if (is_replying)
+        {
+            _send_bit(t);
+        }
+        return;
+    }
+
+    sim_time_t low = t - fall_time;
+
+    if (low >= sim_us_to_ticks(HCS08_POR_LOW_US))
+    {
+        // BKGD held low while the target is powered on: active background mode
+        drive_count = 0;
+        _idle();
+        _reset(true);
+    }
+    else if (low >= HCS08_SYNC_MIN_CYCLES*cycle_ticks)
+    {
+        // SYNC, whatever the decoder was doing
+        sim_time_t start = t + HCS08_SYNC_DELAY_CYCLES*cycle_ticks;
+
+        drive_count = 0;
+        _idle();
+        _drive_low(start, start + HCS08_SYNC_PULSE_CYCLES*cycle_ticks);
+        hcs08.sync_count++;
+    }
+    else if (!is_reply_pulse)
+    {
+        // The target samples the host bit at the 10th cycle
+        _receive_bit(low < HCS08_SAMPLE_CYCLES*cycle_ticks, fall_time);
+    }
+}
@@ -0,0 +1,72 @@
+// Simulated HCS08 target, seen through its BDC on the BKGD line
+//
+// The BDC decodes the host bits from the length of the low pulses (sampled at the 10th cycle),
+// answers SYNC, sends its own bits by holding BKGD low for 13 cycles, and issues ACK pulses
+// when they are enabled. Memory is 64K of RAM, the CPU doesn't execute code: GO runs until a
+// breakpoint (if enabled) or BACKGROUND, TRACE1 moves PC to the next byte.
+
+#ifndef HCS08_TARGET_H_
+#define HCS08_TARGET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sim.h"
+
+// Timing of the BDC, in BDC cycles
+#define HCS08_SAMPLE_CYCLES     10      // Host bit sampled after the falling edge
+#define HCS08_BIT_CYCLES        16      // Length of a bit, from one falling edge to the next
+#define HCS08_ZERO_CYCLES       13      // Target holds BKGD low to send a 0
+#define HCS08_DELAY_CYCLES      16      // Min delay between a command and the first bit read
+#define HCS08_ACK_START_CYCLES  16      // ACK pulse start after the command
+#define HCS08_ACK_PULSE_CYCLES  16      // ACK pulse length
+#define HCS08_SYNC_MIN_CYCLES   128     // Shortest low time taken as SYNC
+#define HCS08_SYNC_DELAY_CYCLES 16      // SYNC response start after the host releases BKGD
+#define HCS08_SYNC_PULSE_CYCLES 128     // SYNC response length
+#define HCS08_RUN_CYCLES        64      // Time to reach the breakpoint after GO
+#define HCS08_POR_LOW_US        1000    // Longer low time: power-on reset with BKGD low (active background)
+
+typedef struct {
+    uint8_t  memory[0x10000];
+    uint8_t  a;
+    uint8_t  ccr;
+    uint16_t pc;
+    uint16_t hx;
+    uint16_t sp;
+    uint8_t  bdcscr;
+    uint16_t bkpt;
+    uint8_t  last_data;         // data of the last memory access (READ_LAST)
+    bool     is_ack_enabled;
+    bool     is_running;
+    bool     is_disconnected;   // BKGD not connected: the target neither sees nor drives it
+    uint32_t bdc_hz;
+
+    // Statistics
+    uint32_t command_count;     // commands executed
+    uint32_t sync_count;        // SYNC answered
+    uint32_t ack_count;         // ACK pulses issued
+    uint32_t ignored_count;     // active background commands received while running
+    uint32_t protocol_errors;   // unknown commands, bits read before the target is ready
+} hcs08_t;
+
+extern hcs08_t hcs08;
+
+// Power on the target: halted in active background mode, memory filled with a pattern
+void hcs08_init(uint32_t bdc_hz);
+
+// BDC clock period in simulated time
+sim_time_t hcs08_cycle_ticks(void);
+
+// The host drive of BKGD changed at time t (level: true = released or driven high)
+void hcs08_host_edge(sim_time_t t, bool level);
+
+// The target holds BKGD low at time t
+bool hcs08_drives_low(sim_time_t t);
+
+// Pattern written in the memory by hcs08_init()
+static inline uint8_t hcs08_pattern(uint32_t addr)
+{
+    return (uint8_t)(addr ^ (addr >> 8) ^ 0x5A);
+}
+
+#endif
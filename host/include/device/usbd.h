@@ -0,0 +1,11 @@
+// Host simulation: no USB device stack, cmd_proc.h only needs what TinyUSB brings in
+// (integer types and string.h, through tusb_common.h)
+
+#ifndef _HOST_DEVICE_USBD_H_
+#define _HOST_DEVICE_USBD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#endif
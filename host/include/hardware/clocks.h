@@ -0,0 +1,37 @@
+// Host build: the system clock is a parameter of the simulator
+
+#ifndef _HARDWARE_CLOCKS_H
+#define _HARDWARE_CLOCKS_H
+
+#include "pico/stdlib.h"
+
+enum clock_index {
+    clk_gpout0 = 0,
+    clk_gpout1,
+    clk_gpout2,
+    clk_gpout3,
+    clk_ref,
+    clk_sys,
+    clk_peri,
+    clk_usb,
+    clk_adc,
+    clk_rtc,
+    CLK_COUNT
+};
+
+// Frequency counter sources (only used by measure_freqs)
+#define CLOCKS_FC0_SRC_VALUE_PLL_SYS_CLKSRC_PRIMARY 0x01
+#define CLOCKS_FC0_SRC_VALUE_PLL_USB_CLKSRC_PRIMARY 0x02
+#define CLOCKS_FC0_SRC_VALUE_ROSC_CLKSRC            0x03
+#define CLOCKS_FC0_SRC_VALUE_CLK_SYS                0x09
+#define CLOCKS_FC0_SRC_VALUE_CLK_PERI               0x0a
+#define CLOCKS_FC0_SRC_VALUE_CLK_USB                0x0b
+#define CLOCKS_FC0_SRC_VALUE_CLK_ADC                0x0c
+#define CLOCKS_FC0_SRC_VALUE_CLK_RTC                0x0d
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+uint32_t frequency_count_khz(uint src);
+void     set_sys_clock_pll(uint32_t vco_freq, uint post_div1, uint post_div2);
+bool     set_sys_clock_khz(uint32_t freq_khz, bool required);
+
+#endif
@@ -0,0 +1,68 @@
+// Host build: DMA channels paced by the emulated PIO FIFOs, see host/pio_emu.c
+
+#ifndef _HARDWARE_DMA_H
+#define _HARDWARE_DMA_H
+
+#include "pico/stdlib.h"
+
+#define NUM_DMA_CHANNELS 12
+
+// PIO DREQs, as numbered on RP2040
+#define DREQ_PIO0_TX0   0
+#define DREQ_PIO0_RX0   4
+#define DREQ_PIO1_TX0   8
+#define DREQ_PIO1_RX0   12
+#define DREQ_FORCE      0x3f
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    bool read_increment;
+    bool write_increment;
+    uint dreq;
+} dma_channel_config;
+
+int  dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    dma_channel_config c = { DMA_SIZE_32, true, false, DREQ_FORCE };
+
+    (void)channel;
+
+    return c;
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+    c->size = size;
+}
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+    c->read_increment = incr;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+    c->write_increment = incr;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+    c->dreq = dreq;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+bool dma_channel_is_busy(uint channel);
+void dma_channel_abort(uint channel);
+void dma_channel_wait_for_finish_blocking(uint channel);
+
+#endif
@@ -0,0 +1,216 @@
+// Host build: PIO blocks emulated at instruction level, see host/pio_emu.c
+//
+// Same API as the pico-sdk for the functions used by the firmware. pio_sm_config holds
+// decoded fields instead of register images.
+
+#ifndef _HARDWARE_PIO_H
+#define _HARDWARE_PIO_H
+
+#include "pico/stdlib.h"
+#include "sim.h"
+
+#define NUM_PIOS                    2
+#define NUM_PIO_STATE_MACHINES      4
+#define PIO_INSTRUCTION_COUNT       32
+#define PIO_FIFO_DEPTH              4
+
+typedef struct {
+    uint32_t clkdiv_256;            // 16.8 fixed point
+    uint8_t  wrap_bottom;
+    uint8_t  wrap_top;
+    uint8_t  sideset_bit_count;     // opt bit included
+    bool     sideset_opt;
+    bool     sideset_pindirs;
+    uint8_t  sideset_base;
+    uint8_t  out_base;
+    uint8_t  out_count;
+    uint8_t  set_base;
+    uint8_t  set_count;
+    uint8_t  in_base;
+    uint8_t  jmp_pin;
+    bool     out_shift_right;
+    bool     in_shift_right;
+    bool     autopull;
+    bool     autopush;
+    uint8_t  pull_threshold;        // 0 = 32
+    uint8_t  push_threshold;        // 0 = 32
+} pio_sm_config;
+
+// State of an emulated state machine
+typedef struct {
+    pio_sm_config config;
+    bool       is_enabled;
+    uint8_t    pc;
+    uint32_t   x;
+    uint32_t   y;
+    uint32_t   osr;
+    uint32_t   isr;
+    uint8_t    osr_count;           // bits shifted out of OSR
+    uint8_t    isr_count;           // bits shifted into ISR
+    uint32_t   tx_fifo[PIO_FIFO_DEPTH];
+    uint8_t    tx_level;
+    uint8_t    tx_head;
+    uint32_t   rx_fifo[PIO_FIFO_DEPTH];
+    uint8_t    rx_level;
+    uint8_t    rx_head;
+    sim_time_t next_time;           // time of the next instruction (or stall retry)
+    bool       is_stalled;          // waiting for a FIFO, no retry until it changes
+    bool       is_parked;           // "jmp" to itself, nothing happens until a restart
+    bool       has_exec;            // instruction forced by pio_sm_exec()
+    uint16_t   exec_instr;
+} pio_sm_state_t;
+
+typedef struct pio_hw {
+    // Only their addresses are used: they are the DMA targets of the FIFOs
+    volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+    volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+
+    uint           index;
+    uint16_t       instr_mem[PIO_INSTRUCTION_COUNT];
+    uint32_t       used_instr_mask;
+    uint8_t        claimed_sm_mask;
+    uint8_t        irq;
+    uint32_t       pin_out;
+    uint32_t       pin_dir;
+    pio_sm_state_t sm[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t pio_hw_sim[NUM_PIOS];
+
+#define pio0 (&pio_hw_sim[0])
+#define pio1 (&pio_hw_sim[1])
+
+struct pio_program {
+    const uint16_t *instructions;
+    uint8_t         length;
+    int8_t          origin;
+};
+
+//--------------------------------------------------------------------+
+// State machine configuration
+//--------------------------------------------------------------------+
+static inline pio_sm_config pio_get_default_sm_config(void)
+{
+    pio_sm_config c = { 0 };
+
+    c.clkdiv_256 = 0x100;
+    c.wrap_bottom = 0;
+    c.wrap_top = 31;
+    c.out_shift_right = true;
+    c.in_shift_right = true;
+
+    return c;
+}
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap)
+{
+    c->wrap_bottom = (uint8_t)wrap_target;
+    c->wrap_top = (uint8_t)wrap;
+}
+
+static inline void sm_config_set_sideset(pio_sm_config *c, uint bit_count, bool optional, bool pindirs)
+{
+    c->sideset_bit_count = (uint8_t)bit_count;
+    c->sideset_opt = optional;
+    c->sideset_pindirs = pindirs;
+}
+
+static inline void sm_config_set_sideset_pins(pio_sm_config *c, uint sideset_base)
+{
+    c->sideset_base = (uint8_t)sideset_base;
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count)
+{
+    c->out_base = (uint8_t)out_base;
+    c->out_count = (uint8_t)out_count;
+}
+
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count)
+{
+    c->set_base = (uint8_t)set_base;
+    c->set_count = (uint8_t)set_count;
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint in_base)
+{
+    c->in_base = (uint8_t)in_base;
+}
+
+static inline void sm_config_set_jmp_pin(pio_sm_config *c, uint pin)
+{
+    c->jmp_pin = (uint8_t)pin;
+}
+
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac)
+{
+    c->clkdiv_256 = ((uint32_t)div_int << 8) | div_frac;
+}
+
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div)
+{
+    uint16_t div_int = (uint16_t)div;
+    uint8_t  div_frac = (uint8_t)((div - (float)div_int) * 256.0f);
+
+    sm_config_set_clkdiv_int_frac(c, div_int, div_frac);
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold)
+{
+    c->out_shift_right = shift_right;
+    c->autopull = autopull;
+    c->pull_threshold = (uint8_t)(pull_threshold & 0x1F);
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold)
+{
+    c->in_shift_right = shift_right;
+    c->autopush = autopush;
+    c->push_threshold = (uint8_t)(push_threshold & 0x1F);
+}
+
+//--------------------------------------------------------------------+
+// PIO API
+//--------------------------------------------------------------------+
+static inline uint pio_get_index(PIO pio)
+{
+    return pio->index;
+}
+
+static inline uint pio_encode_jmp(uint addr)
+{
+    return addr & 0x1F;
+}
+
+uint pio_add_program(PIO pio, const struct pio_program *program);
+void pio_remove_program(PIO pio, const struct pio_program *program, uint loaded_offset);
+int  pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_unclaim(PIO pio, uint sm);
+void pio_gpio_init(PIO pio, uint pin);
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_sm_exec(PIO pio, uint sm, uint instr);
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+
+void     pio_sm_put(PIO pio, uint sm, uint32_t data);
+void     pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get(PIO pio, uint sm);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
+bool     pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+bool     pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+uint     pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint     pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num);
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num);
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx);
+
+#endif
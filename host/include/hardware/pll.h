@@ -0,0 +1,8 @@
+// Host build: see hardware/clocks.h
+
+#ifndef _HARDWARE_PLL_H
+#define _HARDWARE_PLL_H
+
+#include "hardware/clocks.h"
+
+#endif
@@ -0,0 +1,8 @@
+// Host build: see hardware/clocks.h
+
+#ifndef _HARDWARE_STRUCTS_CLOCKS_H
+#define _HARDWARE_STRUCTS_CLOCKS_H
+
+#include "hardware/clocks.h"
+
+#endif
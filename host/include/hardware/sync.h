@@ -0,0 +1,21 @@
+// Host build: __dmb is a full memory barrier, so the SPSC rings also work between two host threads
+
+#ifndef _HARDWARE_SYNC_H
+#define _HARDWARE_SYNC_H
+
+#include "pico/stdlib.h"
+
+static __force_inline void __dmb(void)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static __force_inline void __sev(void)
+{
+}
+
+static __force_inline void __wfe(void)
+{
+}
+
+#endif
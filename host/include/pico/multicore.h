@@ -0,0 +1,13 @@
+// Host build: core 1 isn't simulated, the host program calls the core 1 code directly
+
+#ifndef _PICO_MULTICORE_H
+#define _PICO_MULTICORE_H
+
+#include "pico/stdlib.h"
+
+static inline void multicore_launch_core1(void (*entry)(void))
+{
+    (void)entry;
+}
+
+#endif
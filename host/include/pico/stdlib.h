@@ -0,0 +1,122 @@
+// Host build: the parts of pico/stdlib.h used by the firmware, on top of the simulator (see host/sim.h)
+
+#ifndef _PICO_STDLIB_H
+#define _PICO_STDLIB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef unsigned int uint;
+
+#define count_of(a) (sizeof(a)/sizeof((a)[0]))
+
+#define __force_inline          inline __attribute__((always_inline))
+#define __not_in_flash(group)
+#define __not_in_flash_func(func_name) func_name
+#define __time_critical_func(func_name) func_name
+
+#ifndef MHZ
+#define KHZ 1000
+#define MHZ 1000000
+#endif
+
+//--------------------------------------------------------------------+
+// Time: simulated, see sim_poll()
+//--------------------------------------------------------------------+
+typedef uint64_t absolute_time_t;
+
+absolute_time_t get_absolute_time(void);
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+bool     time_reached(absolute_time_t t);
+void     sleep_us(uint64_t us);
+void     sleep_ms(uint32_t ms);
+void     sleep_until(absolute_time_t t);
+void     busy_wait_us(uint64_t us);
+void     busy_wait_us_32(uint32_t us);
+
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+    return t;
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t)
+{
+    return (uint32_t)(t / 1000);
+}
+
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us)
+{
+    return t + us;
+}
+
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms)
+{
+    return t + 1000ull*ms;
+}
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us)
+{
+    return delayed_by_us(get_absolute_time(), us);
+}
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+    return delayed_by_ms(get_absolute_time(), ms);
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+    return (int64_t)(to - from);
+}
+
+static inline void tight_loop_contents(void)
+{
+}
+
+//--------------------------------------------------------------------+
+// GPIO: only the BKGD pin is connected, see sim_host_drive_changed()
+//--------------------------------------------------------------------+
+enum gpio_function {
+    GPIO_FUNC_XIP  = 0,
+    GPIO_FUNC_SPI  = 1,
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C  = 3,
+    GPIO_FUNC_PWM  = 4,
+    GPIO_FUNC_SIO  = 5,
+    GPIO_FUNC_PIO0 = 6,
+    GPIO_FUNC_PIO1 = 7,
+    GPIO_FUNC_GPCK = 8,
+    GPIO_FUNC_USB  = 9,
+    GPIO_FUNC_NULL = 0x1f,
+};
+
+#define GPIO_OUT 1
+#define GPIO_IN  0
+
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_disable_pulls(uint gpio);
+
+//--------------------------------------------------------------------+
+// stdio: the host one
+//--------------------------------------------------------------------+
+static inline bool stdio_init_all(void)
+{
+    return true;
+}
+
+static inline bool stdio_usb_init(void)
+{
+    return false;
+}
+
+#include "hardware/clocks.h"
+
+#endif
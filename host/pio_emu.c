@@ -0,0 +1,932 @@
+// PIO and DMA emulation
+//
+// Every state machine executes one instruction per PIO clock (clock divider in 16.8 fixed point,
+// see sim_time_t), side-set and delay included. A state machine stalled on a FIFO sleeps until
+// the FIFO changes, a "jmp" to itself sleeps until the next restart, so idle time is free.
+// DMA channels paced by a PIO DREQ move their data as soon as the FIFO allows it.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "pio_emu.h"
+#include "sim.h"
+
+pio_hw_t pio_hw_sim[NUM_PIOS];
+
+typedef struct {
+    bool                           is_claimed;
+    bool                           is_busy;
+    enum dma_channel_transfer_size size;
+    bool                           read_increment;
+    bool                           write_increment;
+    uint                           dreq;
+    volatile uint8_t              *read_addr;
+    volatile uint8_t              *write_addr;
+    uint                           count;
+} dma_channel_t;
+
+static dma_channel_t dma_channels[NUM_DMA_CHANNELS];
+
+static pio_emu_trace_t trace_fn = NULL;
+
+typedef enum {
+    EXEC_DONE,      // pc moves to the next instruction
+    EXEC_JUMP,      // pc has been written
+    EXEC_WAIT,      // condition not met, retry next cycle
+    EXEC_STALL,     // FIFO empty/full, retry when it changes
+} exec_result_t;
+
+static void _panic(const char *message)
+{
+    fprintf(stderr, "pio_emu: %s\n", message);
+    abort();
+}
+
+void pio_emu_reset(void)
+{
+    memset(pio_hw_sim, 0, sizeof(pio_hw_sim));
+    memset(dma_channels, 0, sizeof(dma_channels));
+
+    for (uint i = 0; i < NUM_PIOS; i++)
+    {
+        pio_hw_sim[i].index = i;
+        for (uint sm = 0; sm < NUM_PIO_STATE_MACHINES; sm++)
+        {
+            pio_hw_sim[i].sm[sm].config = pio_get_default_sm_config();
+            pio_hw_sim[i].sm[sm].osr_count = 32;
+        }
+    }
+}
+
+void pio_emu_set_trace(pio_emu_trace_t trace)
+{
+    trace_fn = trace;
+}
+
+static inline uint32_t _clkdiv(pio_sm_state_t *sm)
+{
+    // A zero integer part divides by 65536
+    return (sm->config.clkdiv_256 < 0x100) ? (0x10000u << 8) | sm->config.clkdiv_256 : sm->config.clkdiv_256;
+}
+
+static inline uint _threshold(uint8_t threshold)
+{
+    return (threshold == 0) ? 32 : threshold;
+}
+
+// Next PIO clock edge at or after sim_now
+static void _wake(pio_sm_state_t *sm)
+{
+    sm->is_stalled = false;
+
+    if (sm->next_time < sim_now)
+    {
+        uint32_t   div = _clkdiv(sm);
+        sim_time_t late = sim_now - sm->next_time;
+
+        sm->next_time += ((late + div - 1) / div) * div;
+    }
+}
+
+bool pio_emu_pin_level(PIO pio, uint pin)
+{
+    return ((pio->pin_dir >> pin) & 1) ? ((pio->pin_out >> pin) & 1) : true;
+}
+
+//--------------------------------------------------------------------+
+// FIFOs
+//--------------------------------------------------------------------+
+static bool _tx_push(pio_sm_state_t *sm, uint32_t data)
+{
+    if (sm->tx_level == PIO_FIFO_DEPTH)
+    {
+        return false;
+    }
+    sm->tx_fifo[(sm->tx_head + sm->tx_level++) % PIO_FIFO_DEPTH] = data;
+    if (sm->is_stalled)
+    {
+        _wake(sm);
+    }
+
+    return true;
+}
+
+static bool _tx_pop(pio_sm_state_t *sm, uint32_t *data)
+{
+    if (sm->tx_level == 0)
+    {
+        return false;
+    }
+    *data = sm->tx_fifo[sm->tx_head];
+    sm->tx_head = (sm->tx_head + 1) % PIO_FIFO_DEPTH;
+    sm->tx_level--;
+
+    return true;
+}
+
+static bool _rx_push(pio_sm_state_t *sm, uint32_t data)
+{
+    if (sm->rx_level == PIO_FIFO_DEPTH)
+    {
+        return false;
+    }
+    sm->rx_fifo[(sm->rx_head + sm->rx_level++) % PIO_FIFO_DEPTH] = data;
+
+    return true;
+}
+
+static bool _rx_pop(pio_sm_state_t *sm, uint32_t *data)
+{
+    if (sm->rx_level == 0)
+    {
+        return false;
+    }
+    *data = sm->rx_fifo[sm->rx_head];
+    sm->rx_head = (sm->rx_head + 1) % PIO_FIFO_DEPTH;
+    sm->rx_level--;
+    if (sm->is_stalled)
+    {
+        _wake(sm);
+    }
+
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// DMA
+//--------------------------------------------------------------------+
+static uint32_t _dma_read(dma_channel_t *channel)
+{
+    uint32_t data;
+
+    switch (channel->size)
+    {
+        case DMA_SIZE_8:  data = *channel->read_addr; break;
+        case DMA_SIZE_16: data = *(volatile uint16_t *)channel->read_addr; break;
+        default:          data = *(volatile uint32_t *)channel->read_addr; break;
+    }
+    if (channel->read_increment)
+    {
+        channel->read_addr += 1u << channel->size;
+    }
+
+    return data;
+}
+
+static void _dma_write(dma_channel_t *channel, uint32_t data)
+{
+    // Narrow writes take the low lanes of the FIFO word
+    switch (channel->size)
+    {
+        case DMA_SIZE_8:  *channel->write_addr = (uint8_t)data; break;
+        case DMA_SIZE_16: *(volatile uint16_t *)channel->write_addr = (uint16_t)data; break;
+        default:          *(volatile uint32_t *)channel->write_addr = data; break;
+    }
+    if (channel->write_increment)
+    {
+        channel->write_addr += 1u << channel->size;
+    }
+}
+
+static void _dma_service(void)
+{
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+    {
+        dma_channel_t *channel = &dma_channels[i];
+
+        if (!channel->is_busy)
+        {
+            continue;
+        }
+
+        if (channel->dreq == DREQ_FORCE)
+        {
+            while (channel->count > 0)
+            {
+                _dma_write(channel, _dma_read(channel));
+                channel->count--;
+            }
+        }
+        else
+        {
+            PIO             pio = &pio_hw_sim[channel->dreq / 8];
+            uint            sm_index = channel->dreq % 4;
+            pio_sm_state_t *sm = &pio->sm[sm_index];
+
+            if ((channel->dreq % 8) < 4)
+            {
+                while ((channel->count > 0) && (sm->tx_level < PIO_FIFO_DEPTH))
+                {
+                    _tx_push(sm, _dma_read(channel));
+                    channel->count--;
+                }
+            }
+            else
+            {
+                uint32_t data;
+
+                while ((channel->count > 0) && _rx_pop(sm, &data))
+                {
+                    _dma_write(channel, data);
+                    channel->count--;
+                }
+            }
+        }
+
+        channel->is_busy = (channel->count > 0);
+    }
+}
+
+int dma_claim_unused_channel(bool required)
+{
+    for (uint i = 0; i < NUM_DMA_CHANNELS; i++)
+    {
+        if (!dma_channels[i].is_claimed)
+        {
+            dma_channels[i].is_claimed = true;
+            return (int)i;
+        }
+    }
+    if (required)
+    {
+        _panic("no free DMA channel");
+    }
+
+    return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+    dma_channels[channel].is_claimed = false;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    dma_channel_t *dma = &dma_channels[channel];
+
+    // A PIO DREQ must come with the FIFO register of the same state machine
+    if (config->dreq != DREQ_FORCE)
+    {
+        PIO  pio = &pio_hw_sim[config->dreq / 8];
+        uint sm = config->dreq % 4;
+
+        if (((config->dreq % 8) < 4) ? (write_addr != &pio->txf[sm]) : (read_addr != &pio->rxf[sm]))
+        {
+            _panic("DMA DREQ doesn't match the FIFO address");
+        }
+    }
+
+    dma->size = config->size;
+    dma->read_increment = config->read_increment;
+    dma->write_increment = config->write_increment;
+    dma->dreq = config->dreq;
+    dma->read_addr = (volatile uint8_t *)read_addr;
+    dma->write_addr = (volatile uint8_t *)write_addr;
+    dma->count = transfer_count;
+    dma->is_busy = trigger && (transfer_count > 0);
+
+    _dma_service();
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+    sim_poll();
+
+    return dma_channels[channel].is_busy;
+}
+
+void dma_channel_abort(uint channel)
+{
+    dma_channels[channel].is_busy = false;
+    dma_channels[channel].count = 0;
+}
+
+void dma_channel_wait_for_finish_blocking(uint channel)
+{
+    while (dma_channel_is_busy(channel))
+    {
+    }
+}
+
+//--------------------------------------------------------------------+
+// Instruction execution
+//--------------------------------------------------------------------+
+static void _write_pins(PIO pio, uint base, uint count, uint32_t value, bool is_dir)
+{
+    uint32_t *reg = is_dir ? &pio->pin_dir : &pio->pin_out;
+
+    for (uint i = 0; i < count; i++)
+    {
+        uint pin = (base + i) % 32;
+
+        *reg = (*reg & ~(1u << pin)) | (((value >> i) & 1u) << pin);
+    }
+
+    sim_host_drive_changed();
+}
+
+static uint32_t _read_pins(PIO pio, uint base)
+{
+    uint32_t value = 0;
+
+    for (uint i = 0; i < 32; i++)
+    {
+        uint pin = (base + i) % 32;
+        bool level = (pin == SIM_BKGD_PIN) ? sim_bkgd_level() : ((pio->pin_out >> pin) & 1);
+
+        value |= (uint32_t)level << i;
+    }
+
+    return value;
+}
+
+static inline uint32_t _mask(uint count)
+{
+    return (count >= 32) ? 0xFFFFFFFFu : ((1u << count) - 1);
+}
+
+static uint32_t _bit_reverse(uint32_t value)
+{
+    uint32_t result = 0;
+
+    for (int i = 0; i < 32; i++)
+    {
+        result = (result << 1) | ((value >> i) & 1);
+    }
+
+    return result;
+}
+
+static exec_result_t _execute(PIO pio, uint sm_index, uint16_t instr)
+{
+    pio_sm_state_t *sm = &pio->sm[sm_index];
+    pio_sm_config  *c = &sm->config;
+    uint            arg1 = (instr >> 5) & 7;
+    uint            arg2 = instr & 0x1F;
+
+    switch (instr >> 13)
+    {
+        case 0: // JMP
+        {
+            bool is_taken;
+
+            switch (arg1)
+            {
+                case 0:  is_taken = true; break;
+                case 1:  is_taken = (sm->x == 0); break;
+                case 2:  is_taken = (sm->x != 0); sm->x--; break;
+                case 3:  is_taken = (sm->y == 0); break;
+                case 4:  is_taken = (sm->y != 0); sm->y--; break;
+                case 5:  is_taken = (sm->x != sm->y); break;
+                case 6:  is_taken = (_read_pins(pio, c->jmp_pin) & 1); break;
+                default: is_taken = (sm->osr_count < _threshold(c->pull_threshold)); break;
+            }
+            if (is_taken)
+            {
+                sm->pc = (uint8_t)arg2;
+                return EXEC_JUMP;
+            }
+            return EXEC_DONE;
+        }
+        case 1: // WAIT
+        {
+            bool     polarity = (instr >> 7) & 1;
+            uint     source = (instr >> 5) & 3;
+            bool     level;
+
+            if (source == 0)
+            {
+                level = (_read_pins(pio, 0) >> arg2) & 1;
+            }
+            else if (source == 1)
+            {
+                level = (_read_pins(pio, c->in_base) >> arg2) & 1;
+            }
+            else
+            {
+                uint irq = (arg2 & 0x10) ? ((arg2 & ~3u) | ((arg2 + sm_index) & 3)) & 7 : arg2 & 7;
+
+                level = (pio->irq >> irq) & 1;
+                if (level && polarity)
+                {
+                    pio->irq &= ~(1u << irq);
+                }
+            }
+            return (level == polarity) ? EXEC_DONE : EXEC_WAIT;
+        }
+        case 2: // IN
+        {
+            uint     count = (arg2 == 0) ? 32 : arg2;
+            uint32_t data;
+
+            switch (arg1)
+            {
+                case 0:  data = _read_pins(pio, c->in_base); break;
+                case 1:  data = sm->x; break;
+                case 2:  data = sm->y; break;
+                case 6:  data = sm->isr; break;
+                case 7:  data = sm->osr; break;
+                default: data = 0; break;
+            }
+            data &= _mask(count);
+
+            if (count == 32)
+            {
+                sm->isr = data;
+            }
+            else if (c->in_shift_right)
+            {
+                sm->isr = (sm->isr >> count) | (data << (32 - count));
+            }
+            else
+            {
+                sm->isr = (sm->isr << count) | data;
+            }
+            sm->isr_count = (uint8_t)((sm->isr_count + count > 32) ? 32 : sm->isr_count + count);
+
+            if (c->autopush && (sm->isr_count >= _threshold(c->push_threshold)))
+            {
+                // The state machine would stall here with a full FIFO, this firmware doesn't use autopush
+                _rx_push(sm, sm->isr);
+                sm->isr = 0;
+                sm->isr_count = 0;
+            }
+            return EXEC_DONE;
+        }
+        case 3: // OUT
+        {
+            uint     count = (arg2 == 0) ? 32 : arg2;
+            uint32_t data;
+
+            if (c->autopull && (sm->osr_count >= _threshold(c->pull_threshold)))
+            {
+                if (!_tx_pop(sm, &sm->osr))
+                {
+                    return EXEC_STALL;
+                }
+                sm->osr_count = 0;
+            }
+
+            if (count == 32)
+            {
+                data = sm->osr;
+                sm->osr = 0;
+            }
+            else if (c->out_shift_right)
+            {
+                data = sm->osr & _mask(count);
+                sm->osr >>= count;
+            }
+            else
+            {
+                data = sm->osr >> (32 - count);
+                sm->osr <<= count;
+            }
+            sm->osr_count = (uint8_t)((sm->osr_count + count > 32) ? 32 : sm->osr_count + count);
+
+            switch (arg1)
+            {
+                case 0: _write_pins(pio, c->out_base, c->out_count, data, false); break;
+                case 1: sm->x = data; break;
+                case 2: sm->y = data; break;
+                case 4: _write_pins(pio, c->out_base, c->out_count, data, true); break;
+                case 5: sm->pc = (uint8_t)(data & 0x1F); return EXEC_JUMP;
+                case 6: sm->isr = data; sm->isr_count = (uint8_t)count; break;
+                case 7: sm->has_exec = true; sm->exec_instr = (uint16_t)data; break;
+                default: break;
+            }
+            return EXEC_DONE;
+        }
+        case 4: // PUSH/PULL
+        {
+            bool is_if = (instr >> 6) & 1;
+            bool is_block = (instr >> 5) & 1;
+
+            if (instr & 0x80)
+            {
+                if (is_if && (sm->osr_count < _threshold(c->pull_threshold)))
+                {
+                    return EXEC_DONE;
+                }
+                if (!_tx_pop(sm, &sm->osr))
+                {
+                    if (is_block)
+                    {
+                        return EXEC_STALL;
+                    }
+                    sm->osr = sm->x;
+                }
+                sm->osr_count = 0;
+            }
+            else
+            {
+                if (is_if && (sm->isr_count < _threshold(c->push_threshold)))
+                {
+                    return EXEC_DONE;
+                }
+                if (!_rx_push(sm, sm->isr) && is_block)
+                {
+                    return EXEC_STALL;
+                }
+                sm->isr = 0;
+                sm->isr_count = 0;
+            }
+            return EXEC_DONE;
+        }
+        case 5: // MOV
+        {
+            uint32_t data;
+
+            switch (instr & 7)
+            {
+                case 0:  data = _read_pins(pio, c->in_base); break;
+                case 1:  data = sm->x; break;
+                case 2:  data = sm->y; break;
+                case 6:  data = sm->isr; break;
+                case 7:  data = sm->osr; break;
+                default: data = 0; break;
+            }
+            if (((instr >> 3) & 3) == 1)
+            {
+                data = ~data;
+            }
+            else if (((instr >> 3) & 3) == 2)
+            {
+                data = _bit_reverse(data);
+            }
+
+            switch (arg1)
+            {
+                case 0: _write_pins(pio, c->out_base, c->out_count, data, false); break;
+                case 1: sm->x = data; break;
+                case 2: sm->y = data; break;
+                case 4: sm->has_exec = true; sm->exec_instr = (uint16_t)data; break;
+                case 5: sm->pc = (uint8_t)(data & 0x1F); return EXEC_JUMP;
+                case 6: sm->isr = data; sm->isr_count = 0; break;
+                case 7: sm->osr = data; sm->osr_count = 0; break;
+                default: break;
+            }
+            return EXEC_DONE;
+        }
+        case 6: // IRQ
+        {
+            uint irq = (arg2 & 0x10) ? ((arg2 & 4) | ((arg2 + sm_index) & 3)) : arg2 & 7;
+
+            if (instr & 0x40)
+            {
+                pio->irq &= ~(1u << irq);
+            }
+            else
+            {
+                pio->irq |= 1u << irq;
+            }
+            return EXEC_DONE;
+        }
+        default: // SET
+        {
+            switch (arg1)
+            {
+                case 0: _write_pins(pio, c->set_base, c->set_count, arg2, false); break;
+                case 1: sm->x = arg2; break;
+                case 2: sm->y = arg2; break;
+                case 4: _write_pins(pio, c->set_base, c->set_count, arg2, true); break;
+                default: break;
+            }
+            return EXEC_DONE;
+        }
+    }
+}
+
+// Execute the next instruction of a state machine, at sim_now
+static void _step(PIO pio, uint sm_index)
+{
+    pio_sm_state_t *sm = &pio->sm[sm_index];
+    pio_sm_config  *c = &sm->config;
+    uint            pc = sm->pc;
+    bool            is_exec = sm->has_exec;
+    uint16_t        instr = is_exec ? sm->exec_instr : pio->instr_mem[pc];
+    uint            delay_bits = 5u - c->sideset_bit_count;
+    uint            field = (instr >> 8) & 0x1F;
+    uint            delay = field & ((1u << delay_bits) - 1);
+
+    sm->has_exec = false;
+
+    // Side-set takes effect at the start of the instruction, stalled or not
+    if (c->sideset_bit_count > 0)
+    {
+        uint side = field >> delay_bits;
+        uint count = c->sideset_bit_count;
+        bool is_enabled = true;
+
+        if (c->sideset_opt)
+        {
+            count--;
+            is_enabled = (side >> count) & 1;
+        }
+        if (is_enabled)
+        {
+            _write_pins(pio, c->sideset_base, count, side, c->sideset_pindirs);
+        }
+    }
+
+    exec_result_t result = _execute(pio, sm_index, instr);
+
+    if ((result == EXEC_WAIT) || (result == EXEC_STALL))
+    {
+        // Retry the same instruction
+        if (is_exec)
+        {
+            sm->has_exec = true;
+        }
+        sm->is_stalled = (result == EXEC_STALL);
+        sm->next_time += _clkdiv(sm);
+        return;
+    }
+
+    if (result == EXEC_JUMP)
+    {
+        // An unconditional jmp to itself never ends, until the state machine is restarted
+        sm->is_parked = ((instr & 0xE0E0) == 0x0000) && (sm->pc == pc) && !is_exec;
+    }
+    else if (!is_exec)
+    {
+        sm->pc = (pc == c->wrap_top) ? c->wrap_bottom : (uint8_t)((pc + 1) % PIO_INSTRUCTION_COUNT);
+    }
+
+    if (trace_fn != NULL)
+    {
+        trace_fn(pio, sm_index, pc, instr, sim_now);
+    }
+
+    sm->next_time += (1 + delay) * (sim_time_t)_clkdiv(sm);
+}
+
+sim_time_t pio_emu_next_time(void)
+{
+    sim_time_t next = SIM_TIME_NEVER;
+
+    for (uint p = 0; p < NUM_PIOS; p++)
+    {
+        for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+        {
+            pio_sm_state_t *sm = &pio_hw_sim[p].sm[i];
+
+            if (sm->is_enabled && !sm->is_stalled && !sm->is_parked && (sm->next_time < next))
+            {
+                next = sm->next_time;
+            }
+        }
+    }
+
+    return next;
+}
+
+void pio_emu_step(void)
+{
+    for (uint p = 0; p < NUM_PIOS; p++)
+    {
+        for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+        {
+            pio_sm_state_t *sm = &pio_hw_sim[p].sm[i];
+
+            if (sm->is_enabled && !sm->is_stalled && !sm->is_parked && (sm->next_time <= sim_now))
+            {
+                _step(&pio_hw_sim[p], i);
+            }
+        }
+    }
+
+    _dma_service();
+}
+
+//--------------------------------------------------------------------+
+// hardware/pio.h
+//--------------------------------------------------------------------+
+uint pio_add_program(PIO pio, const struct pio_program *program)
+{
+    uint64_t program_mask = (1ull << program->length) - 1;
+    int      offset = program->origin;
+
+    if (offset < 0)
+    {
+        // Highest free space, as the SDK does
+        for (offset = PIO_INSTRUCTION_COUNT - program->length; offset >= 0; offset--)
+        {
+            if (((program_mask << offset) & pio->used_instr_mask) == 0)
+            {
+                break;
+            }
+        }
+    }
+    if ((offset < 0) || ((program_mask << offset) & pio->used_instr_mask) ||
+        (offset + program->length > PIO_INSTRUCTION_COUNT))
+    {
+        _panic("no program space");
+    }
+
+    for (uint i = 0; i < program->length; i++)
+    {
+        uint16_t instr = program->instructions[i];
+
+        // JMP targets are relative to the program
+        pio->instr_mem[offset + i] = ((instr >> 13) == 0) ? (uint16_t)(instr + offset) : instr;
+    }
+    pio->used_instr_mask |= (uint32_t)(program_mask << offset);
+
+    return (uint)offset;
+}
+
+void pio_remove_program(PIO pio, const struct pio_program *program, uint loaded_offset)
+{
+    pio->used_instr_mask &= ~(uint32_t)(((1ull << program->length) - 1) << loaded_offset);
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+    for (uint i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+    {
+        if (!(pio->claimed_sm_mask & (1u << i)))
+        {
+            pio->claimed_sm_mask |= (uint8_t)(1u << i);
+            return (int)i;
+        }
+    }
+    if (required)
+    {
+        _panic("no free state machine");
+    }
+
+    return -1;
+}
+
+void pio_sm_unclaim(PIO pio, uint sm)
+{
+    pio->claimed_sm_mask &= (uint8_t)~(1u << sm);
+}
+
+void pio_gpio_init(PIO pio, uint pin)
+{
+    gpio_set_function(pin, (pio->index == 0) ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1);
+}
+
+void pio_sm_set_config(PIO pio, uint sm, const pio_sm_config *config)
+{
+    pio->sm[sm].config = *config;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config)
+{
+    pio_sm_set_enabled(pio, sm, false);
+
+    if (config != NULL)
+    {
+        pio_sm_set_config(pio, sm, config);
+    }
+    else
+    {
+        pio_sm_config c = pio_get_default_sm_config();
+
+        pio_sm_set_config(pio, sm, &c);
+    }
+
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(initial_pc));
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+    pio_sm_state_t *state = &pio->sm[sm];
+
+    if (enabled && !state->is_enabled)
+    {
+        state->next_time = sim_now;
+    }
+    state->is_enabled = enabled;
+}
+
+void pio_sm_restart(PIO pio, uint sm)
+{
+    pio_sm_state_t *state = &pio->sm[sm];
+
+    state->isr_count = 0;
+    state->osr_count = 32;
+    state->is_stalled = false;
+    state->is_parked = false;
+    state->has_exec = false;
+    state->next_time = sim_now;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm)
+{
+    pio_sm_state_t *state = &pio->sm[sm];
+
+    state->tx_level = 0;
+    state->rx_level = 0;
+    if (state->is_stalled)
+    {
+        _wake(state);
+    }
+}
+
+void pio_sm_exec(PIO pio, uint sm, uint instr)
+{
+    pio_sm_state_t *state = &pio->sm[sm];
+
+    // Executed at once, without its delay. pc only changes with a jump.
+    _execute(pio, sm, (uint16_t)instr);
+    state->is_parked = false;
+    if (state->is_stalled)
+    {
+        _wake(state);
+    }
+}
+
+void pio_sm_set_clkdiv_int_frac(PIO pio, uint sm, uint16_t div_int, uint8_t div_frac)
+{
+    pio->sm[sm].config.clkdiv_256 = ((uint32_t)div_int << 8) | div_frac;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out)
+{
+    (void)sm;
+
+    _write_pins(pio, pin_base, pin_count, is_out ? 0xFFFFFFFFu : 0, true);
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data)
+{
+    // A write to a full FIFO is lost
+    _tx_push(&pio->sm[sm], data);
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data)
+{
+    while (pio_sm_is_tx_fifo_full(pio, sm))
+    {
+    }
+    pio_sm_put(pio, sm, data);
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm)
+{
+    uint32_t data = 0;
+
+    // An empty FIFO reads as zero
+    _rx_pop(&pio->sm[sm], &data);
+
+    return data;
+}
+
+uint32_t pio_sm_get_blocking(PIO pio, uint sm)
+{
+    while (pio_sm_is_rx_fifo_empty(pio, sm))
+    {
+    }
+
+    return pio_sm_get(pio, sm);
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm)
+{
+    sim_poll();
+
+    return pio->sm[sm].rx_level == 0;
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm)
+{
+    sim_poll();
+
+    return pio->sm[sm].tx_level == PIO_FIFO_DEPTH;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm)
+{
+    sim_poll();
+
+    return pio->sm[sm].rx_level;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm)
+{
+    sim_poll();
+
+    return pio->sm[sm].tx_level;
+}
+
+bool pio_interrupt_get(PIO pio, uint pio_interrupt_num)
+{
+    return (pio->irq >> pio_interrupt_num) & 1;
+}
+
+void pio_interrupt_clear(PIO pio, uint pio_interrupt_num)
+{
+    pio->irq &= ~(1u << pio_interrupt_num);
+}
+
+uint pio_get_dreq(PIO pio, uint sm, bool is_tx)
+{
+    return pio->index*8 + (is_tx ? 0 : 4) + sm;
+}
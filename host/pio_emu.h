@@ -0,0 +1,34 @@
+// PIO and DMA emulation: the simulator side of hardware/pio.h and hardware/dma.h
+
+#ifndef PIO_EMU_H_
+#define PIO_EMU_H_
+
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+
+//! Called after every executed instruction
+//!
+//! @param pio   : PIO block
+//! @param sm    : state machine
+//! @param pc    : address of the instruction
+//! @param instr : instruction
+//! @param start : time the instruction started (its delay is not included)
+//!
+typedef void (*pio_emu_trace_t)(PIO pio, uint sm, uint pc, uint16_t instr, sim_time_t start);
+
+// Reset both PIO blocks and every DMA channel
+void pio_emu_reset(void);
+
+// Time of the next instruction of any running state machine (SIM_TIME_NEVER if none)
+sim_time_t pio_emu_next_time(void);
+
+// Execute the instructions due at sim_now, then move the DMA data
+void pio_emu_step(void);
+
+// Level driven on a pin by a PIO block (true when it doesn't drive the pin)
+bool pio_emu_pin_level(PIO pio, uint pin);
+
+// Install a trace callback (NULL to remove it)
+void pio_emu_set_trace(pio_emu_trace_t trace);
+
+#endif
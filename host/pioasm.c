@@ -0,0 +1,692 @@
+// Host assembler for the PIO programs of this project
+//
+// Subset of the pico-sdk pioasm, enough for bdm-data.pio and bdm-sync.pio:
+//   .program, .side_set <n> [opt] [pindirs], .wrap_target, .wrap, .origin, labels,
+//   jmp, wait, in, out, push, pull, mov, irq, set, nop, "side <v>", "[<delay>]"
+//   and "% c-sdk { ... %}" blocks.
+// The generated header has the same layout as the pioasm one, so the firmware sources
+// build unchanged against the host mock of hardware/pio.h.
+//
+// Usage: pioasm <input.pio> <output.h>
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_INSTRUCTIONS 32
+#define MAX_LABELS       64
+#define MAX_PROGRAMS     4
+#define MAX_LINE         512
+
+typedef struct {
+    char name[64];
+    int  addr;
+} label_t;
+
+typedef struct {
+    char text[MAX_LINE];    // source without label and comment
+    int  line;
+} source_instr_t;
+
+typedef struct {
+    char           name[64];
+    int            side_count;      // side-set bits, opt bit excluded
+    bool           side_opt;
+    bool           side_pindirs;
+    int            wrap_target;
+    int            wrap;
+    int            origin;
+    label_t        labels[MAX_LABELS];
+    int            label_count;
+    source_instr_t source[MAX_INSTRUCTIONS];
+    uint16_t       code[MAX_INSTRUCTIONS];
+    int            length;
+    char          *c_sdk;           // "% c-sdk" block, verbatim
+} program_t;
+
+static program_t programs[MAX_PROGRAMS];
+static int program_count = 0;
+static const char *input_name;
+
+static void _error(int line, const char *format, ...)
+{
+    va_list args;
+
+    fprintf(stderr, "%s:%d: error: ", input_name, line);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static char *_trim(char *str)
+{
+    while (isspace((unsigned char)*str))
+    {
+        str++;
+    }
+
+    char *end = str + strlen(str);
+
+    while ((end > str) && isspace((unsigned char)end[-1]))
+    {
+        *--end = '\0';
+    }
+
+    return str;
+}
+
+static void _lower(char *str)
+{
+    for (; *str; str++)
+    {
+        *str = (char)tolower((unsigned char)*str);
+    }
+}
+
+static bool _parse_int(const char *str, int *value)
+{
+    char *end;
+    long  result = strtol(str, &end, 0);
+
+    if ((*str == '\0') || (*end != '\0'))
+    {
+        return false;
+    }
+
+    *value = (int)result;
+
+    return true;
+}
+
+static void _append(char **buffer, const char *text)
+{
+    size_t old_size = (*buffer != NULL) ? strlen(*buffer) : 0;
+
+    *buffer = realloc(*buffer, old_size + strlen(text) + 1);
+    strcpy(*buffer + old_size, text);
+}
+
+// Split "a, b c" into tokens, commas and blanks are separators
+static int _tokens(char *str, char **tokens, int max_tokens)
+{
+    int count = 0;
+
+    for (char *token = strtok(str, " \t,"); (token != NULL) && (count < max_tokens); token = strtok(NULL, " \t,"))
+    {
+        tokens[count++] = token;
+    }
+
+    return count;
+}
+
+static int _lookup(int line, const char *name, const char *const *names, int count, const char *what)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if ((names[i] != NULL) && (strcmp(name, names[i]) == 0))
+        {
+            return i;
+        }
+    }
+
+    _error(line, "invalid %s '%s'", what, name);
+    return -1;
+}
+
+static int _bit_count(int line, const char *str, int min, int max)
+{
+    int value;
+
+    if (!_parse_int(str, &value) || (value < min) || (value > max))
+    {
+        _error(line, "bit count '%s' must be in [%d, %d]", str, min, max);
+    }
+
+    return value & 0x1F;
+}
+
+static int _label_addr(program_t *program, int line, const char *name)
+{
+    int value;
+
+    if (_parse_int(name, &value))
+    {
+        return value;
+    }
+
+    for (int i = 0; i < program->label_count; i++)
+    {
+        if (strcmp(program->labels[i].name, name) == 0)
+        {
+            return program->labels[i].addr;
+        }
+    }
+
+    _error(line, "unknown label '%s'", name);
+    return 0;
+}
+
+// Encode one instruction, side-set and delay included
+static uint16_t _encode(program_t *program, source_instr_t *source)
+{
+    static const char *const jmp_conds[]  = { "", "!x", "x--", "!y", "y--", "x!=y", "pin", "!osre" };
+    static const char *const in_srcs[]    = { "pins", "x", "y", "null", NULL, NULL, "isr", "osr" };
+    static const char *const out_dests[]  = { "pins", "x", "y", "null", "pindirs", "pc", "isr", "exec" };
+    static const char *const mov_dests[]  = { "pins", "x", "y", NULL, "exec", "pc", "isr", "osr" };
+    static const char *const mov_srcs[]   = { "pins", "x", "y", "null", NULL, "status", "isr", "osr" };
+    static const char *const set_dests[]  = { "pins", "x", "y", NULL, "pindirs" };
+    static const char *const wait_srcs[]  = { "gpio", "pin", "irq" };
+
+    char  text[MAX_LINE];
+    char *tokens[8];
+    int   line = source->line;
+    int   side = -1;
+    int   delay = 0;
+
+    strcpy(text, source->text);
+    _lower(text);
+
+    // Delay: "[n]" at the end
+    char *bracket = strchr(text, '[');
+
+    if (bracket != NULL)
+    {
+        char *close = strchr(bracket, ']');
+
+        if (close == NULL)
+        {
+            _error(line, "missing ']'");
+        }
+        *close = '\0';
+        if (!_parse_int(_trim(bracket+1), &delay) || (delay < 0))
+        {
+            _error(line, "invalid delay");
+        }
+        *bracket = '\0';
+    }
+
+    // Side-set: "side v"
+    char *side_str = strstr(text, " side ");
+
+    if (side_str != NULL)
+    {
+        if (!_parse_int(_trim(side_str+6), &side))
+        {
+            _error(line, "invalid side-set value");
+        }
+        *side_str = '\0';
+    }
+
+    int count = _tokens(text, tokens, 8);
+    const char *op = tokens[0];
+    uint16_t instr;
+
+    if (strcmp(op, "nop") == 0)
+    {
+        // mov y, y
+        instr = 0xA042;
+    }
+    else if (strcmp(op, "jmp") == 0)
+    {
+        int cond = (count == 3) ? _lookup(line, tokens[1], jmp_conds, 8, "jmp condition") : 0;
+
+        if ((count != 2) && (count != 3))
+        {
+            _error(line, "jmp needs a target");
+        }
+        instr = (uint16_t)(0x0000 | (cond<<5) | _label_addr(program, line, tokens[count-1]));
+    }
+    else if (strcmp(op, "wait") == 0)
+    {
+        int polarity;
+
+        if ((count != 4) || !_parse_int(tokens[1], &polarity) || (polarity > 1))
+        {
+            _error(line, "wait needs polarity, source and index");
+        }
+        int index;
+
+        if (!_parse_int(tokens[3], &index))
+        {
+            _error(line, "invalid wait index");
+        }
+        instr = (uint16_t)(0x2000 | (polarity<<7) | (_lookup(line, tokens[2], wait_srcs, 3, "wait source")<<5) | (index & 0x1F));
+    }
+    else if (strcmp(op, "in") == 0)
+    {
+        if (count != 3)
+        {
+            _error(line, "in needs a source and a bit count");
+        }
+        instr = (uint16_t)(0x4000 | (_lookup(line, tokens[1], in_srcs, 8, "in source")<<5) | _bit_count(line, tokens[2], 1, 32));
+    }
+    else if (strcmp(op, "out") == 0)
+    {
+        if (count != 3)
+        {
+            _error(line, "out needs a destination and a bit count");
+        }
+        instr = (uint16_t)(0x6000 | (_lookup(line, tokens[1], out_dests, 8, "out destination")<<5) | _bit_count(line, tokens[2], 1, 32));
+    }
+    else if ((strcmp(op, "push") == 0) || (strcmp(op, "pull") == 0))
+    {
+        bool is_pull = (op[1] == 'u') && (op[2] == 'l');
+        int  if_flag = 0;
+        int  block = 1;
+
+        for (int i = 1; i < count; i++)
+        {
+            if (strcmp(tokens[i], is_pull ? "ifempty" : "iffull") == 0)
+            {
+                if_flag = 1;
+            }
+            else if (strcmp(tokens[i], "block") == 0)
+            {
+                block = 1;
+            }
+            else if (strcmp(tokens[i], "noblock") == 0)
+            {
+                block = 0;
+            }
+            else
+            {
+                _error(line, "invalid %s option '%s'", op, tokens[i]);
+            }
+        }
+        instr = (uint16_t)(0x8000 | (is_pull ? 0x80 : 0) | (if_flag<<6) | (block<<5));
+    }
+    else if (strcmp(op, "mov") == 0)
+    {
+        if (count != 3)
+        {
+            _error(line, "mov needs a destination and a source");
+        }
+
+        const char *src = tokens[2];
+        int         mov_op = 0;
+
+        if ((src[0] == '!') || (src[0] == '~'))
+        {
+            mov_op = 1;
+            src += 1;
+        }
+        else if (strncmp(src, "::", 2) == 0)
+        {
+            mov_op = 2;
+            src += 2;
+        }
+        instr = (uint16_t)(0xA000 | (_lookup(line, tokens[1], mov_dests, 8, "mov destination")<<5) |
+                           (mov_op<<3) | _lookup(line, src, mov_srcs, 8, "mov source"));
+    }
+    else if (strcmp(op, "irq") == 0)
+    {
+        int mode = 0;   // set
+        int index;
+        int i = 1;
+
+        if ((i < count) && (strcmp(tokens[i], "set") == 0 || strcmp(tokens[i], "nowait") == 0))
+        {
+            i++;
+        }
+        else if ((i < count) && (strcmp(tokens[i], "wait") == 0))
+        {
+            mode = 1;
+            i++;
+        }
+        else if ((i < count) && (strcmp(tokens[i], "clear") == 0))
+        {
+            mode = 2;
+            i++;
+        }
+        if ((i >= count) || !_parse_int(tokens[i], &index) || (index > 7))
+        {
+            _error(line, "invalid irq index");
+        }
+        if ((i+1 < count) && (strcmp(tokens[i+1], "rel") == 0))
+        {
+            index |= 0x10;
+        }
+        instr = (uint16_t)(0xC000 | ((mode == 2) ? 0x40 : 0) | ((mode == 1) ? 0x20 : 0) | index);
+    }
+    else if (strcmp(op, "set") == 0)
+    {
+        int value;
+
+        if ((count != 3) || !_parse_int(tokens[2], &value) || (value < 0) || (value > 31))
+        {
+            _error(line, "set needs a destination and a value in [0, 31]");
+        }
+        instr = (uint16_t)(0xE000 | (_lookup(line, tokens[1], set_dests, 5, "set destination")<<5) | value);
+    }
+    else
+    {
+        _error(line, "unknown instruction '%s'", op);
+        return 0;
+    }
+
+    // Delay/side-set field [12:8]: side-set enable (opt), side-set value, then delay
+    int side_bits  = program->side_count + (program->side_opt ? 1 : 0);
+    int delay_max  = (1 << (5 - side_bits)) - 1;
+    int field      = delay;
+
+    if (delay > delay_max)
+    {
+        _error(line, "delay %d is too large, max is %d", delay, delay_max);
+    }
+
+    if (side >= 0)
+    {
+        if (program->side_count == 0)
+        {
+            _error(line, "side-set used without .side_set");
+        }
+        if (side >= (1 << program->side_count))
+        {
+            _error(line, "side-set value %d doesn't fit in %d bit", side, program->side_count);
+        }
+        field |= side << (5 - side_bits);
+        if (program->side_opt)
+        {
+            field |= 0x10;
+        }
+    }
+    else if ((program->side_count > 0) && !program->side_opt)
+    {
+        _error(line, "side-set is mandatory, use .side_set %d opt", program->side_count);
+    }
+
+    return (uint16_t)(instr | (field << 8));
+}
+
+static void _parse(FILE *in)
+{
+    char      buffer[MAX_LINE];
+    int       line = 0;
+    program_t *program = NULL;
+    bool      in_c_sdk = false;
+    bool      skip_block = false;
+
+    while (fgets(buffer, sizeof(buffer), in) != NULL)
+    {
+        line++;
+
+        if (in_c_sdk)
+        {
+            char copy[MAX_LINE];
+
+            strcpy(copy, buffer);
+            if (strncmp(_trim(copy), "%}", 2) == 0)
+            {
+                in_c_sdk = false;
+            }
+            else if (!skip_block)
+            {
+                _append(&program->c_sdk, buffer);
+            }
+            continue;
+        }
+
+        // Comments
+        char *comment = strchr(buffer, ';');
+
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+        comment = strstr(buffer, "//");
+        if (comment != NULL)
+        {
+            *comment = '\0';
+        }
+
+        char *text = _trim(buffer);
+
+        if (*text == '\0')
+        {
+            continue;
+        }
+
+        if (text[0] == '%')
+        {
+            if (program == NULL)
+            {
+                _error(line, "code block outside of a program");
+            }
+            // Only the c-sdk blocks are used by this build
+            skip_block = (strstr(text, "c-sdk") == NULL);
+            in_c_sdk = true;
+            continue;
+        }
+
+        if (text[0] == '.')
+        {
+            char *tokens[4] = { NULL };
+            int   count = _tokens(text, tokens, 4);
+
+            if (strcmp(tokens[0], ".program") == 0)
+            {
+                if ((count != 2) || (program_count == MAX_PROGRAMS))
+                {
+                    _error(line, "invalid .program");
+                }
+                program = &programs[program_count++];
+                memset(program, 0, sizeof(*program));
+                strncpy(program->name, tokens[1], sizeof(program->name)-1);
+                program->wrap_target = -1;
+                program->wrap = -1;
+                program->origin = -1;
+                continue;
+            }
+            if (program == NULL)
+            {
+                _error(line, "directive outside of a program");
+            }
+            if (strcmp(tokens[0], ".side_set") == 0)
+            {
+                if ((count < 2) || !_parse_int(tokens[1], &program->side_count) || (program->side_count > 5))
+                {
+                    _error(line, "invalid .side_set");
+                }
+                for (int i = 2; i < count; i++)
+                {
+                    if (strcmp(tokens[i], "opt") == 0)
+                    {
+                        program->side_opt = true;
+                    }
+                    else if (strcmp(tokens[i], "pindirs") == 0)
+                    {
+                        program->side_pindirs = true;
+                    }
+                    else
+                    {
+                        _error(line, "invalid .side_set option '%s'", tokens[i]);
+                    }
+                }
+                if (program->side_count + (program->side_opt ? 1 : 0) > 5)
+                {
+                    _error(line, "too many side-set bits");
+                }
+            }
+            else if (strcmp(tokens[0], ".wrap_target") == 0)
+            {
+                program->wrap_target = program->length;
+            }
+            else if (strcmp(tokens[0], ".wrap") == 0)
+            {
+                if (program->length == 0)
+                {
+                    _error(line, ".wrap before any instruction");
+                }
+                program->wrap = program->length - 1;
+            }
+            else if (strcmp(tokens[0], ".origin") == 0)
+            {
+                if ((count != 2) || !_parse_int(tokens[1], &program->origin))
+                {
+                    _error(line, "invalid .origin");
+                }
+            }
+            else
+            {
+                _error(line, "unsupported directive '%s'", tokens[0]);
+            }
+            continue;
+        }
+
+        if (program == NULL)
+        {
+            _error(line, "instruction outside of a program");
+        }
+
+        // Label
+        char *colon = strchr(text, ':');
+
+        if ((colon != NULL) && (colon[1] != ':'))
+        {
+            *colon = '\0';
+
+            if (program->label_count == MAX_LABELS)
+            {
+                _error(line, "too many labels");
+            }
+            label_t *label = &program->labels[program->label_count++];
+
+            strncpy(label->name, _trim(text), sizeof(label->name)-1);
+            label->addr = program->length;
+            text = _trim(colon+1);
+
+            if (*text == '\0')
+            {
+                continue;
+            }
+        }
+
+        if (program->length == MAX_INSTRUCTIONS)
+        {
+            _error(line, "program '%s' is longer than %d instructions", program->name, MAX_INSTRUCTIONS);
+        }
+        source_instr_t *source = &program->source[program->length++];
+
+        strcpy(source->text, text);
+        source->line = line;
+    }
+
+    if (in_c_sdk)
+    {
+        _error(line, "missing %%}");
+    }
+}
+
+static void _write(FILE *out)
+{
+    fprintf(out, "// -------------------------------------------------- //\n");
+    fprintf(out, "// This file is autogenerated by pioasm; do not edit! //\n");
+    fprintf(out, "// (host build, see host/pioasm.c)                    //\n");
+    fprintf(out, "// -------------------------------------------------- //\n\n");
+    fprintf(out, "#pragma once\n\n");
+    fprintf(out, "#if !PICO_NO_HARDWARE\n#include \"hardware/pio.h\"\n#endif\n\n");
+
+    for (int p = 0; p < program_count; p++)
+    {
+        program_t *program = &programs[p];
+
+        if (program->wrap_target < 0)
+        {
+            program->wrap_target = 0;
+        }
+        if (program->wrap < 0)
+        {
+            program->wrap = program->length - 1;
+        }
+
+        fprintf(out, "// %.*s //\n", (int)strlen(program->name), "--------------------------------------------------------------");
+        fprintf(out, "// %s //\n", program->name);
+        fprintf(out, "// %.*s //\n\n", (int)strlen(program->name), "--------------------------------------------------------------");
+        fprintf(out, "#define %s_wrap_target %d\n", program->name, program->wrap_target);
+        fprintf(out, "#define %s_wrap %d\n\n", program->name, program->wrap);
+        fprintf(out, "static const uint16_t %s_program_instructions[] = {\n", program->name);
+
+        for (int i = 0; i < program->length; i++)
+        {
+            if (i == program->wrap_target)
+            {
+                fprintf(out, "            //     .wrap_target\n");
+            }
+            fprintf(out, "    0x%04x, // %2d: %s\n", program->code[i], i, program->source[i].text);
+            if (i == program->wrap)
+            {
+                fprintf(out, "            //     .wrap\n");
+            }
+        }
+        fprintf(out, "};\n\n");
+
+        fprintf(out, "#if !PICO_NO_HARDWARE\n");
+        fprintf(out, "static const struct pio_program %s_program = {\n", program->name);
+        fprintf(out, "    .instructions = %s_program_instructions,\n", program->name);
+        fprintf(out, "    .length = %d,\n", program->length);
+        fprintf(out, "    .origin = %d,\n", program->origin);
+        fprintf(out, "};\n\n");
+        fprintf(out, "static inline pio_sm_config %s_program_get_default_config(uint offset) {\n", program->name);
+        fprintf(out, "    pio_sm_config c = pio_get_default_sm_config();\n");
+        fprintf(out, "    sm_config_set_wrap(&c, offset + %s_wrap_target, offset + %s_wrap);\n", program->name, program->name);
+        if (program->side_count > 0)
+        {
+            fprintf(out, "    sm_config_set_sideset(&c, %d, %s, %s);\n", program->side_count + (program->side_opt ? 1 : 0),
+                    program->side_opt ? "true" : "false", program->side_pindirs ? "true" : "false");
+        }
+        fprintf(out, "    return c;\n}\n");
+        if (program->c_sdk != NULL)
+        {
+            fprintf(out, "\n%s", program->c_sdk);
+        }
+        fprintf(out, "#endif\n\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc != 3)
+    {
+        fprintf(stderr, "usage: %s <input.pio> <output.h>\n", argv[0]);
+        return 2;
+    }
+
+    input_name = argv[1];
+
+    FILE *in = fopen(argv[1], "r");
+
+    if (in == NULL)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    _parse(in);
+    fclose(in);
+
+    // Encode before opening the output, so a failed build leaves no header behind
+    for (int p = 0; p < program_count; p++)
+    {
+        for (int i = 0; i < programs[p].length; i++)
+        {
+            programs[p].code[i] = _encode(&programs[p], &programs[p].source[i]);
+        }
+    }
+
+    FILE *out = fopen(argv[2], "w");
+
+    if (out == NULL)
+    {
+        perror(argv[2]);
+        return 1;
+    }
+    _write(out);
+    fclose(out);
+
+    return 0;
+}
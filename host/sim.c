@@ -0,0 +1,271 @@
+// Host simulation: simulated time, clocks, GPIO and the BKGD line (see sim.h)
+
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "sim.h"
+#include "pio_emu.h"
+#include "hcs08_target.h"
+
+#define NUM_GPIOS 30
+
+sim_time_t sim_now = 0;
+
+static uint32_t sys_hz = 125000000;
+
+// GPIO function and SIO state of every pin
+static uint8_t  gpio_function[NUM_GPIOS];
+static uint32_t sio_out = 0;
+static uint32_t sio_dir = 0;
+
+// Last host level of BKGD given to the target
+static bool host_level = true;
+
+void sim_reset(uint32_t hz)
+{
+    sys_hz = hz;
+    sim_now = 0;
+    sio_out = 0;
+    sio_dir = 0;
+    host_level = true;
+
+    for (int i = 0; i < NUM_GPIOS; i++)
+    {
+        gpio_function[i] = GPIO_FUNC_NULL;
+    }
+
+    pio_emu_reset();
+}
+
+uint32_t sim_sys_hz(void)
+{
+    return sys_hz;
+}
+
+sim_time_t sim_us_to_ticks(uint64_t us)
+{
+    unsigned __int128 ticks = (unsigned __int128)us * sys_hz * SIM_TICKS_PER_CYCLE;
+
+    return (sim_time_t)((ticks + MHZ - 1) / MHZ);
+}
+
+uint64_t sim_ticks_to_us(sim_time_t ticks)
+{
+    return (uint64_t)(((unsigned __int128)ticks * MHZ) / ((uint64_t)sys_hz * SIM_TICKS_PER_CYCLE));
+}
+
+void sim_run_until(sim_time_t time)
+{
+    for (;;)
+    {
+        sim_time_t next = pio_emu_next_time();
+
+        if (next > time)
+        {
+            break;
+        }
+        if (next > sim_now)
+        {
+            sim_now = next;
+        }
+        pio_emu_step();
+    }
+
+    if (time > sim_now)
+    {
+        sim_now = time;
+    }
+}
+
+void sim_poll(void)
+{
+    sim_run_until(sim_now + SIM_POLL_CYCLES*SIM_TICKS_PER_CYCLE);
+}
+
+// Level driven on BKGD by the host, according to the function of the pin
+static bool _host_drive(void)
+{
+    switch (gpio_function[SIM_BKGD_PIN])
+    {
+        case GPIO_FUNC_SIO:
+            return ((sio_dir >> SIM_BKGD_PIN) & 1) ? ((sio_out >> SIM_BKGD_PIN) & 1) : true;
+        case GPIO_FUNC_PIO0:
+            return pio_emu_pin_level(pio0, SIM_BKGD_PIN);
+        case GPIO_FUNC_PIO1:
+            return pio_emu_pin_level(pio1, SIM_BKGD_PIN);
+        default:
+            return true;
+    }
+}
+
+void sim_host_drive_changed(void)
+{
+    bool level = _host_drive();
+
+    if (level != host_level)
+    {
+        host_level = level;
+        hcs08_host_edge(sim_now, level);
+    }
+}
+
+bool sim_bkgd_level(void)
+{
+    return host_level && !hcs08_drives_low(sim_now);
+}
+
+//--------------------------------------------------------------------+
+// pico/stdlib.h: time
+//--------------------------------------------------------------------+
+absolute_time_t get_absolute_time(void)
+{
+    sim_poll();
+
+    return sim_ticks_to_us(sim_now);
+}
+
+uint64_t time_us_64(void)
+{
+    return get_absolute_time();
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t)get_absolute_time();
+}
+
+bool time_reached(absolute_time_t t)
+{
+    return get_absolute_time() >= t;
+}
+
+void sleep_until(absolute_time_t t)
+{
+    sim_run_until(sim_us_to_ticks(t));
+}
+
+void sleep_us(uint64_t us)
+{
+    sim_run_until(sim_now + sim_us_to_ticks(us));
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sleep_us(1000ull*ms);
+}
+
+void busy_wait_us(uint64_t us)
+{
+    sleep_us(us);
+}
+
+void busy_wait_us_32(uint32_t us)
+{
+    sleep_us(us);
+}
+
+//--------------------------------------------------------------------+
+// hardware/clocks.h
+//--------------------------------------------------------------------+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+    switch (clk_index)
+    {
+        case clk_sys:
+        case clk_peri:
+            return sys_hz;
+        case clk_usb:
+        case clk_adc:
+            return 48*MHZ;
+        case clk_ref:
+            return 12*MHZ;
+        default:
+            return 0;
+    }
+}
+
+uint32_t frequency_count_khz(uint src)
+{
+    return (src == CLOCKS_FC0_SRC_VALUE_CLK_SYS) ? sys_hz / KHZ : 0;
+}
+
+void set_sys_clock_pll(uint32_t vco_freq, uint post_div1, uint post_div2)
+{
+    sys_hz = vco_freq / (post_div1 * post_div2);
+}
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required)
+{
+    (void)required;
+
+    sys_hz = freq_khz * KHZ;
+
+    return true;
+}
+
+//--------------------------------------------------------------------+
+// pico/stdlib.h: GPIO
+//--------------------------------------------------------------------+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    gpio_function[gpio] = (uint8_t)fn;
+    sim_host_drive_changed();
+}
+
+void gpio_init(uint gpio)
+{
+    sio_dir &= ~(1u << gpio);
+    sio_out &= ~(1u << gpio);
+    gpio_set_function(gpio, GPIO_FUNC_SIO);
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+    if (out)
+    {
+        sio_dir |= 1u << gpio;
+    }
+    else
+    {
+        sio_dir &= ~(1u << gpio);
+    }
+    sim_host_drive_changed();
+}
+
+void gpio_put(uint gpio, bool value)
+{
+    if (value)
+    {
+        sio_out |= 1u << gpio;
+    }
+    else
+    {
+        sio_out &= ~(1u << gpio);
+    }
+    sim_host_drive_changed();
+}
+
+bool gpio_get(uint gpio)
+{
+    sim_poll();
+
+    if (gpio == SIM_BKGD_PIN)
+    {
+        return sim_bkgd_level();
+    }
+
+    return (sio_out >> gpio) & 1;
+}
+
+void gpio_pull_up(uint gpio)
+{
+    // BKGD is always pulled up
+    (void)gpio;
+}
+
+void gpio_disable_pulls(uint gpio)
+{
+    (void)gpio;
+}
@@ -0,0 +1,50 @@
+// Host simulation of the USBDM board: simulated time, BKGD line and the CPU side of the clocks/GPIO/time APIs
+//
+// Nothing runs on its own: the PIO state machines, the DMA channels and the target only move
+// when the firmware waits (sleep, timeout, FIFO or DMA poll). Every poll costs SIM_POLL_CYCLES
+// system clock cycles, the rest of the CPU time is free.
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+//! Simulated time, in 1/256 of a system clock cycle (the resolution of the PIO clock dividers)
+typedef uint64_t sim_time_t;
+
+#define SIM_TICKS_PER_CYCLE     (256u)
+#define SIM_TIME_NEVER          UINT64_MAX
+
+//! System clock cycles charged to every poll of the hardware or of the time
+#define SIM_POLL_CYCLES         (8u)
+
+//! GPIO of the BKGD line (DATA_PIN in config.h)
+#define SIM_BKGD_PIN            (15u)
+
+//! Current simulated time
+extern sim_time_t sim_now;
+
+// Reset the simulated time and the hardware (GPIO, PIO, DMA), the target is left alone
+void sim_reset(uint32_t sys_hz);
+
+// Simulated system clock, see set_sys_clock_pll()
+uint32_t sim_sys_hz(void);
+
+// Conversions between simulated time and us (rounded up to the next tick)
+sim_time_t sim_us_to_ticks(uint64_t us);
+uint64_t   sim_ticks_to_us(sim_time_t ticks);
+
+// Run the PIO state machines, DMA and target up to the given time
+void sim_run_until(sim_time_t time);
+
+// CPU poll of the hardware: SIM_POLL_CYCLES pass
+void sim_poll(void);
+
+// Tell the line that the host drive of BKGD may have changed (GPIO function, SIO or PIO pins)
+void sim_host_drive_changed(void);
+
+// Level of the BKGD line now: wired-AND of the host and of the target, pulled up
+bool sim_bkgd_level(void);
+
+#endif
@@ -0,0 +1,174 @@
+// CRC32 of target memory (target_mem_crc32() and CMD_USBDM_CRC32_MEM) against the zlib
+// check values, and CMD_USBDM_VERIFY_MEM, with the data in the simulated target
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "config.h"
+#include "bdm.h"
+#include "cmd_proc.h"
+#include "target_mem.h"
+#include "sim.h"
+#include "hcs08_target.h"
+
+#define TEST_ADDR   0x0200
+
+static uint8_t verify_buffer[6 + MAX_EXT_MEM_SIZE];
+static int failures = 0;
+
+// Bitwise CRC32, reference for the table driven one
+static uint32_t _crc32_reference(const uint8_t *data, uint32_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+        }
+    }
+
+    return ~crc;
+}
+
+static void _check(const char *name, uint16_t addr, uint32_t length, uint32_t expected)
+{
+    uint32_t crc = 0;
+    uint8_t  rc = target_mem_crc32(addr, length, &crc);
+
+    if ((rc != BDM_RC_OK) || (crc != expected))
+    {
+        printf("FAIL %s: status %u, CRC32 0x%08X, expected 0x%08X\n", name, rc, crc, expected);
+        failures++;
+    }
+}
+
+// VERIFY_MEM of count bytes at addr against the target memory, one byte changed at bad_offset
+// (count: no change), returns the status
+static uint8_t _verify(uint16_t addr, uint32_t count, uint32_t bad_offset)
+{
+    verify_buffer[1] = CMD_USBDM_VERIFY_MEM;
+    verify_buffer[2] = (uint8_t)(addr >> 8);
+    verify_buffer[3] = (uint8_t)addr;
+    verify_buffer[4] = (uint8_t)(count >> 8);
+    verify_buffer[5] = (uint8_t)count;
+    for (uint32_t i = 0; (i < count) && (i < MAX_EXT_MEM_SIZE); i++)
+    {
+        verify_buffer[6 + i] = hcs08.memory[(addr + i) & 0xFFFF];
+    }
+    if (bad_offset < count)
+    {
+        verify_buffer[6 + bad_offset] ^= 0x01;
+    }
+
+    uint32_t size = 6 + ((count < MAX_EXT_MEM_SIZE) ? count : MAX_EXT_MEM_SIZE);
+
+    command_exec(verify_buffer, (uint16_t)size);
+
+    return verify_buffer[0];
+}
+
+static void _check_verify(const char *name, uint16_t addr, uint32_t count, uint32_t bad_offset)
+{
+    uint8_t  rc = _verify(addr, count, bad_offset);
+    bool     is_match = (verify_buffer[1] == 0);
+    uint16_t mismatch_addr = (uint16_t)((verify_buffer[2] << 8) | verify_buffer[3]);
+
+    if ((rc != BDM_RC_OK) || (is_match != (bad_offset >= count)) ||
+        (!is_match && (mismatch_addr != (uint16_t)(addr + bad_offset))))
+    {
+        printf("FAIL %s: status %u, match %u, mismatch at 0x%04X\n", name, rc, is_match, mismatch_addr);
+        failures++;
+    }
+}
+
+static void _check_string(const char *text, uint32_t expected)
+{
+    memcpy(&hcs08.memory[TEST_ADDR], text, strlen(text));
+    _check(text, TEST_ADDR, (uint32_t)strlen(text), expected);
+}
+
+int main(void)
+{
+    uint8_t buffer[8] = { 0, CMD_USBDM_CONNECT };
+
+    set_sys_clock_pll(VCO_FREQ * MHZ, POST_DEV1, POST_DEV2);
+    sim_reset(clock_get_hz(clk_sys));
+    hcs08_init(8*MHZ);
+    bdm_pio_init();
+
+    command_exec(buffer, 2);
+    if (buffer[0] != BDM_RC_OK)
+    {
+        printf("FAIL connect\n");
+        return EXIT_FAILURE;
+    }
+
+    // zlib crc32() check values
+    _check_string("123456789", 0xCBF43926);
+    _check_string("a", 0xE8B7BE43);
+    _check_string("abc", 0x352441C2);
+    _check_string("The quick brown fox jumps over the lazy dog", 0x414FA339);
+    _check("empty range", TEST_ADDR, 0, 0x00000000);
+
+    // Several bursts of TARGET_MEM_CHUNK bytes, and the top of the address space
+    _check("3 bursts", 0x1000, 3*TARGET_MEM_CHUNK + 7, _crc32_reference(&hcs08.memory[0x1000], 3*TARGET_MEM_CHUNK + 7));
+    _check("top of memory", 0xFF00, 0x100, _crc32_reference(&hcs08.memory[0xFF00], 0x100));
+
+    // Same through the USBDM command, CRC32 big endian in the response
+    memcpy(&hcs08.memory[TEST_ADDR], "123456789", 9);
+    buffer[1] = CMD_USBDM_CRC32_MEM;
+    buffer[2] = (uint8_t)(TEST_ADDR >> 8);
+    buffer[3] = (uint8_t)TEST_ADDR;
+    buffer[4] = 0;
+    buffer[5] = 9;
+    command_exec(buffer, 6);
+
+    uint32_t crc = ((uint32_t)buffer[1] << 24) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 8) | buffer[4];
+
+    if ((buffer[0] != BDM_RC_OK) || (crc != 0xCBF43926))
+    {
+        printf("FAIL CMD_USBDM_CRC32_MEM: status %u, CRC32 0x%08X\n", buffer[0], crc);
+        failures++;
+    }
+
+    // A range past the end of the address space is refused
+    buffer[1] = CMD_USBDM_CRC32_MEM;
+    buffer[2] = 0xFF;
+    buffer[3] = 0x00;
+    buffer[4] = 0x01;
+    buffer[5] = 0x01;
+    command_exec(buffer, 6);
+
+    if (buffer[0] != BDM_RC_ILLEGAL_PARAMS)
+    {
+        printf("FAIL CMD_USBDM_CRC32_MEM past 0xFFFF: status %u\n", buffer[0]);
+        failures++;
+    }
+
+    // VERIFY_MEM, blocks longer than a legacy command (extended framing) up to MAX_EXT_MEM_SIZE
+    _check_verify("VERIFY match", 0x1000, 100, 100);
+    _check_verify("VERIFY mismatch", 0x1000, 100, 37);
+    _check_verify("VERIFY extended match", 0x2000, MAX_EXT_MEM_SIZE, MAX_EXT_MEM_SIZE);
+    _check_verify("VERIFY extended mismatch", 0x2000, MAX_EXT_MEM_SIZE, MAX_EXT_MEM_SIZE - 3);
+    _check_verify("VERIFY top of memory", 0xFF00, 0x100, 0x100);
+
+    if (_verify(0xFF00, 0x101, 0x101) != BDM_RC_ILLEGAL_PARAMS)
+    {
+        printf("FAIL CMD_USBDM_VERIFY_MEM past 0xFFFF: status %u\n", verify_buffer[0]);
+        failures++;
+    }
+    if (_verify(0x2000, MAX_EXT_MEM_SIZE + 1, MAX_EXT_MEM_SIZE + 1) != BDM_RC_ILLEGAL_PARAMS)
+    {
+        printf("FAIL CMD_USBDM_VERIFY_MEM over MAX_EXT_MEM_SIZE: status %u\n", verify_buffer[0]);
+        failures++;
+    }
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,55 @@
+// bdm_frame_header(): bit layout of the bdm-data frame header (see bdm-data.pio)
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pio_functions.h"
+
+static int failures = 0;
+
+static void _check(const char *what, uint header, uint expected)
+{
+    if (header != expected)
+    {
+        printf("FAIL %s: header 0x%08X, expected 0x%08X\n", what, header, expected);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    // [31:24] tx bits - 1, [23:16] rx bits
+    _check("READ_NEXT",   bdm_frame_header(8, 8, false, 0),    0x07080000);
+    _check("WRITE_NEXT",  bdm_frame_header(16, 0, false, 0),   0x0F000000);
+    _check("READ_BYTE",   bdm_frame_header(24, 16, false, 0),  0x17100000);
+    _check("32 tx bits",  bdm_frame_header(32, 0, false, 0),   0x1F000000);
+    _check("1 tx bit",    bdm_frame_header(1, 32, false, 0),   0x00200000);
+
+    // [15] no delay
+    _check("READ_STATUS", bdm_frame_header(8, 8, true, 0),     0x07088000);
+
+    // [14] ACK, [13:0] timeout
+    _check("ACK",         bdm_frame_header(8, 8, false, 100),  0x07084064);
+    _check("ACK max",     bdm_frame_header(16, 0, false, 0x3FFF), 0x0F007FFF);
+
+    // The timeout is cut to 14 bits, it never spills into the flags
+    _check("ACK wrap",    bdm_frame_header(16, 0, false, 0x4001), 0x0F004001);
+    _check("ACK flags",   bdm_frame_header(8, 0, false, 0xFFFF) & 0xC000, 0x4000);
+
+    // Zero timeout means the fixed delay (WAIT)
+    _check("WAIT",        bdm_frame_header(8, 0, false, 0) & 0xFFFF, 0);
+
+    // Wire time follows the header fields
+    _check("cycles READ_NEXT",   bdm_frame_cycles(bdm_frame_header(8, 8, false, 0)),
+           6 + 8*BDM_BIT_CYCLES + BDM_DELAY_CYCLES + 8*BDM_BIT_CYCLES + 1);
+    _check("cycles WRITE_NEXT",  bdm_frame_cycles(bdm_frame_header(16, 0, false, 0)),
+           6 + 16*BDM_BIT_CYCLES + BDM_DELAY_CYCLES + 2);
+    _check("cycles READ_STATUS", bdm_frame_cycles(bdm_frame_header(8, 8, true, 0)),
+           6 + 8*BDM_BIT_CYCLES + 5 + 8*BDM_BIT_CYCLES + 1);
+    _check("max cycles ACK",     bdm_frame_max_cycles(bdm_frame_header(8, 8, false, 100)),
+           bdm_frame_cycles(bdm_frame_header(8, 8, false, 100)) + 2*100);
+    _check("max cycles no delay", bdm_frame_max_cycles(bdm_frame_header(8, 8, true, 100)),
+           bdm_frame_cycles(bdm_frame_header(8, 8, true, 100)));
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
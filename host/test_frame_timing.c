@@ -0,0 +1,199 @@
+// bdm-data.pio run cycle by cycle on the PIO emulator, against the simulated HCS08 target
+//
+// For each frame format used by bdm.c:
+//  - the wire time from the header pull to the push must be bdm_frame_cycles()
+//  - the first rx bit must not fall before the target is ready (HCS08_DELAY_CYCLES after the
+//    last tx bit), and with the fixed delay it falls BDM_DELAY_CYCLES + 1 cycles after it
+//  - the received data must be the target's
+// and the wire time of a streamed byte (READ_NEXT, WRITE_NEXT) must not grow.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "config.h"
+#include "bdm.h"
+#include "pio_functions.h"
+#include "sim.h"
+#include "pio_emu.h"
+#include "hcs08_target.h"
+
+// Wire time of one streamed byte, in BDC cycles. Lower them when the program gets faster.
+#define READ_NEXT_MAX_CYCLES    278
+#define WRITE_NEXT_MAX_CYCLES   279
+
+#define ACK_TIMEOUT_LOOPS       0x100
+#define MAX_FALLS               80
+
+static PIO        pio = pio0;
+static uint       sm = 0;
+static uint       pio_cycle_ticks;
+
+// Trace of the current frame
+static sim_time_t pull_time;
+static sim_time_t push_time;
+static sim_time_t falls[MAX_FALLS];
+static uint       fall_count;
+static bool       is_pulled;
+
+static int failures = 0;
+
+static void _trace(PIO trace_pio, uint trace_sm, uint pc, uint16_t instr, sim_time_t start)
+{
+    if ((trace_pio != pio) || (trace_sm != sm))
+    {
+        return;
+    }
+
+    // pull: the first one of a frame is the header
+    if (((instr & 0xE080) == 0x8080) && !is_pulled)
+    {
+        is_pulled = true;
+        pull_time = start;
+        fall_count = 0;
+    }
+    // push ends the frame
+    else if ((instr & 0xE080) == 0x8000)
+    {
+        is_pulled = false;
+        push_time = start;
+    }
+
+    // side 0: falling edge of a bit, tx or rx
+    if (((instr >> 11) & 3) == 2 && (fall_count < MAX_FALLS))
+    {
+        falls[fall_count++] = start;
+    }
+    (void)pc;
+}
+
+static uint _cycles(sim_time_t ticks)
+{
+    return (uint)(ticks / pio_cycle_ticks);
+}
+
+// Run one frame, return its measured wire time in PIO cycles
+static uint _run_frame(const char *name, uint tx_bit, uint rx_bit, bool no_delay, bool ack, uint data, uint *rx)
+{
+    uint header = bdm_frame_header(tx_bit, rx_bit, no_delay, ack ? ACK_TIMEOUT_LOOPS : 0);
+    uint frame[2] = { header, data << (32 - tx_bit) };
+    uint errors = hcs08.protocol_errors;
+
+    hcs08.is_ack_enabled = ack;
+
+    do_bdm_burst(pio, sm, frame, 1, rx, DMA_SIZE_32);
+    if (!wait_end_burst(10000) || (pio->irq & 1))
+    {
+        printf("FAIL %s: frame not completed\n", name);
+        pio->irq = 0;
+        failures++;
+        return 0;
+    }
+
+    uint measured = _cycles(push_time - pull_time) + 1;
+    uint expected = bdm_frame_cycles(header);
+    uint gap = _cycles(falls[tx_bit] - falls[tx_bit-1]) - BDM_BIT_CYCLES;
+
+    printf("%-14s %2u/%-2u %-8s %4u cycles (model %4u)", name, tx_bit, rx_bit,
+           no_delay ? "no delay" : (ack ? "ACK" : "WAIT"), measured, expected);
+    if (rx_bit > 0)
+    {
+        printf(", rx after %u cycles", gap + BDM_BIT_CYCLES);
+    }
+    printf("\n");
+
+    if (measured != expected)
+    {
+        printf("FAIL %s: bdm_frame_cycles() is %u, bdm-data.pio takes %u\n", name, expected, measured);
+        failures++;
+    }
+    if (fall_count != tx_bit + rx_bit)
+    {
+        printf("FAIL %s: %u falling edges, expected %u\n", name, fall_count, tx_bit + rx_bit);
+        failures++;
+    }
+    else if ((rx_bit > 0) && !no_delay && !ack && (gap != BDM_DELAY_CYCLES + 1))
+    {
+        printf("FAIL %s: first rx bit falls %u cycles after the command, expected %u\n",
+               name, gap, BDM_DELAY_CYCLES + 1);
+        failures++;
+    }
+    if ((rx_bit > 0) && !no_delay && (gap < HCS08_DELAY_CYCLES))
+    {
+        printf("FAIL %s: first rx bit falls %u cycles after the command, the target needs %u\n",
+               name, gap, HCS08_DELAY_CYCLES);
+        failures++;
+    }
+    if (hcs08.protocol_errors != errors)
+    {
+        printf("FAIL %s: protocol error seen by the target\n", name);
+        failures++;
+    }
+
+    return measured;
+}
+
+static void _check_rx(const char *name, uint rx, uint expected)
+{
+    if (rx != expected)
+    {
+        printf("FAIL %s: received 0x%X, expected 0x%X\n", name, rx, expected);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    uint rx;
+
+    // One PIO cycle per BDC cycle: PIO_FREQ divides the sys clock, the target runs at PIO_FREQ
+    set_sys_clock_pll(VCO_FREQ * MHZ, POST_DEV1, POST_DEV2);
+    sim_reset(clock_get_hz(clk_sys));
+    hcs08_init(PIO_FREQ);
+    pio_cycle_ticks = (clock_get_hz(clk_sys) / PIO_FREQ) * SIM_TICKS_PER_CYCLE;
+
+    bdm_dma_init();
+    bdm_init(pio, sm, PIO_FREQ);
+    pio_emu_set_trace(_trace);
+
+    for (int ack = 0; ack <= 1; ack++)
+    {
+        _run_frame("READ_STATUS", 8, 8, true, false, READ_STATUS, &rx);
+        _check_rx("READ_STATUS", rx, hcs08.bdcscr);
+        _run_frame("WRITE_BKPT", 24, 0, true, false, (WRITE_BKPT << 16) | 0x1234, &rx);
+        _check_rx("WRITE_BKPT", hcs08.bkpt, 0x1234);
+        _run_frame("BACKGROUND", 8, 0, false, ack, BACKGROUND, &rx);
+        _run_frame("WRITE_A", 16, 0, false, ack, (WRITE_A << 8) | 0xA5, &rx);
+        _run_frame("READ_A", 8, 8, false, ack, READ_A, &rx);
+        _check_rx("READ_A", rx, 0xA5);
+        _run_frame("WRITE_HX", 24, 0, false, ack, (WRITE_HX << 16) | 0x0FFF, &rx);
+        _run_frame("READ_PC", 8, 16, false, ack, READ_PC, &rx);
+        _check_rx("READ_PC", rx, hcs08.pc);
+        _run_frame("READ_BYTE", 24, 8, false, ack, (READ_BYTE << 16) | 0x0200, &rx);
+        _check_rx("READ_BYTE", rx, hcs08.memory[0x0200]);
+        _run_frame("WRITE_BYTE", 32, 0, false, ack, ((uint)WRITE_BYTE << 24) | (0x0201 << 8) | 0x3C, &rx);
+        _check_rx("WRITE_BYTE", hcs08.memory[0x0201], 0x3C);
+        _run_frame("READ_BYTE_WS", 24, 16, false, ack, (READ_BYTE_WS << 16) | 0x0201, &rx);
+        _check_rx("READ_BYTE_WS", rx & 0xFF, 0x3C);
+
+        uint read_next = _run_frame("READ_NEXT", 8, 8, false, ack, READ_NEXT, &rx);
+        _check_rx("READ_NEXT", rx, hcs08.memory[hcs08.hx]);
+        uint write_next = _run_frame("WRITE_NEXT", 16, 0, false, ack, (WRITE_NEXT << 8) | 0x69, &rx);
+        _check_rx("WRITE_NEXT", hcs08.memory[hcs08.hx], 0x69);
+
+        if (!ack && (read_next > READ_NEXT_MAX_CYCLES))
+        {
+            printf("FAIL READ_NEXT: %u cycles per byte, was %u\n", read_next, READ_NEXT_MAX_CYCLES);
+            failures++;
+        }
+        if (!ack && (write_next > WRITE_NEXT_MAX_CYCLES))
+        {
+            printf("FAIL WRITE_NEXT: %u cycles per byte, was %u\n", write_next, WRITE_NEXT_MAX_CYCLES);
+            failures++;
+        }
+    }
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,82 @@
+// Speed guess (bdm_guess_speed()) against the simulated target: the speed is found when the
+// target answers, and the previous speed is kept when it answers at no frequency
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "config.h"
+#include "bdm.h"
+#include "cmd_proc.h"
+#include "sim.h"
+#include "hcs08_target.h"
+
+static int failures = 0;
+
+static void _check_status(const char *name)
+{
+    uint8_t status = 0;
+    uint8_t rc = bdm_get_status(&status);
+
+    if ((rc != BDM_RC_OK) || (status != hcs08.bdcscr))
+    {
+        printf("FAIL %s: status %u, BDCSCR 0x%02X, expected 0x%02X\n", name, rc, status, hcs08.bdcscr);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    uint8_t buffer[8] = { 0, CMD_USBDM_CONNECT };
+
+    set_sys_clock_pll(VCO_FREQ * MHZ, POST_DEV1, POST_DEV2);
+    sim_reset(clock_get_hz(clk_sys));
+    hcs08_init(8*MHZ);
+    bdm_pio_init();
+
+    command_exec(buffer, 2);
+    if (buffer[0] != BDM_RC_OK)
+    {
+        printf("FAIL connect\n");
+        return EXIT_FAILURE;
+    }
+
+    uint16_t sync_length = bdm_cmd_get_sync_length();
+
+    // The target answers: a speed is found and commands work at it
+    if (!bdm_guess_speed())
+    {
+        printf("FAIL guess: no speed found\n");
+        failures++;
+    }
+    _check_status("guessed speed");
+
+    // Back to the SYNC speed
+    if (!bdm_cmd_sync() || (bdm_cmd_get_sync_length() != sync_length))
+    {
+        printf("FAIL sync: sync length %u, expected %u\n", bdm_cmd_get_sync_length(), sync_length);
+        failures++;
+    }
+
+    // The target answers at no frequency: no speed, the previous one is kept
+    hcs08.is_disconnected = true;
+
+    if (bdm_guess_speed())
+    {
+        printf("FAIL guess: speed found without a target\n");
+        failures++;
+    }
+    if (bdm_cmd_get_sync_length() != sync_length)
+    {
+        printf("FAIL guess: sync length %u after a failed guess, expected %u\n",
+               bdm_cmd_get_sync_length(), sync_length);
+        failures++;
+    }
+
+    hcs08.is_disconnected = false;
+    _check_status("kept speed");
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,100 @@
+// CMD_USBDM_RUN_UNTIL with RUN_UNTIL_GO against the simulated target: the condition is checked
+// after the first step, and at the breakpoint
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "config.h"
+#include "bdm.h"
+#include "cmd_proc.h"
+#include "BDM_options.h"
+#include "sim.h"
+#include "hcs08_target.h"
+
+#define STATUS_POLLS    100     // READ_STATUS_REG before giving up on the halt
+
+static uint8_t buffer[MAX_COMMAND_SIZE + 8];
+static int failures = 0;
+
+static uint8_t _exec(uint16_t size)
+{
+    command_exec(buffer, size);
+
+    return buffer[0];
+}
+
+static void _write_pc(uint16_t pc)
+{
+    memset(buffer, 0, sizeof(buffer));
+    buffer[1] = CMD_USBDM_WRITE_REG;
+    buffer[3] = HCS08_RegPC;
+    buffer[6] = (uint8_t)(pc >> 8);
+    buffer[7] = (uint8_t)pc;
+    _exec(8);
+}
+
+// Run until PC is outside [first, last], wait for the final halt
+static void _check_run(const char *name, uint16_t first, uint16_t last, uint16_t expected_pc)
+{
+    buffer[1] = CMD_USBDM_RUN_UNTIL;
+    buffer[2] = RUN_UNTIL_GO;
+    buffer[3] = RUN_UNTIL_PC_OUTSIDE;
+    buffer[4] = (uint8_t)(first >> 8);
+    buffer[5] = (uint8_t)first;
+    buffer[6] = (uint8_t)(last >> 8);
+    buffer[7] = (uint8_t)last;
+    if (_exec(8) != BDM_RC_OK)
+    {
+        printf("FAIL %s: RUN_UNTIL status %u\n", name, buffer[0]);
+        failures++;
+        return;
+    }
+
+    bool is_halted = false;
+
+    for (uint i = 0; (i < STATUS_POLLS) && !is_halted; i++)
+    {
+        buffer[1] = CMD_USBDM_READ_STATUS_REG;
+        is_halted = (_exec(2) == BDM_RC_OK) && (buffer[4] & HCS_BDCSCR_BDMACT);
+    }
+
+    if (!is_halted || (hcs08.pc != expected_pc))
+    {
+        printf("FAIL %s: %s, PC 0x%04X, expected 0x%04X\n", name,
+               is_halted ? "halted" : "still running", hcs08.pc, expected_pc);
+        failures++;
+    }
+}
+
+int main(void)
+{
+    set_sys_clock_pll(VCO_FREQ * MHZ, POST_DEV1, POST_DEV2);
+    sim_reset(clock_get_hz(clk_sys));
+    hcs08_init(8*MHZ);
+    bdm_pio_init();
+
+    buffer[1] = CMD_USBDM_CONNECT;
+    if (_exec(2) != BDM_RC_OK)
+    {
+        printf("FAIL connect\n");
+        return EXIT_FAILURE;
+    }
+
+    // Breakpoint out of the way, the target would run for ever without one
+    hcs08.bkpt = 0x9000;
+
+    // The first step leaves the range: no GO, the target stays halted after it
+    _write_pc(0x8000);
+    _check_run("met after the first step", 0x8000, 0x8000, 0x8001);
+
+    // Still in the range after the step: GO, met at the breakpoint
+    hcs08.bdcscr |= 0x20;   // BKPTEN
+    _write_pc(0x8000);
+    _check_run("met at the breakpoint", 0x8000, 0x80FF, 0x9000);
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
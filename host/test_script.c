@@ -0,0 +1,178 @@
+// script_exec(): well-formed scripts against the simulated target, and rejection of the
+// malformed ones (unknown opcodes, truncated operands, bad counts, branches out of the
+// script, result overflow, endless loops and delays over the time budget)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+
+#include "config.h"
+#include "bdm.h"
+#include "cmd_proc.h"
+#include "script.h"
+#include "sim.h"
+#include "hcs08_target.h"
+
+static uint8_t result[64];
+static uint    result_size;
+static int     failures = 0;
+
+static uint8_t _run(const uint8_t *script, uint size, uint result_max)
+{
+    memset(result, 0, sizeof(result));
+
+    return script_exec(script, size, result, result_max, &result_size);
+}
+
+static void _expect(const char *name, const uint8_t *script, uint size, uint8_t rc)
+{
+    uint8_t status = _run(script, size, sizeof(result));
+
+    if (status != rc)
+    {
+        printf("FAIL %s: status %u, expected %u\n", name, status, rc);
+        failures++;
+    }
+}
+
+static void _expect_result(const char *name, const uint8_t *expected, uint size)
+{
+    if ((result_size != size) || (memcmp(result, expected, size) != 0))
+    {
+        printf("FAIL %s: wrong result (%u bytes, expected %u)\n", name, result_size, size);
+        failures++;
+    }
+}
+
+static void _test_valid(void)
+{
+    hcs08.memory[0x0080] = 0x12;
+    hcs08.memory[0x0081] = 0x34;
+    hcs08.memory[0x0085] = 0x56;
+
+    const uint8_t script[] = {
+        SOP_BDM, 1, 1, READ_STATUS,             // BDCSCR
+        SOP_READ_MEM, 0x00, 0x80, 2,            // 0x12 0x34, ACC = 0x34
+        SOP_WRITE_MEM, 0x00, 0x90, 2, 0xAB, 0xCD,
+        SOP_READ_MEM | SOP_QUIET, 0x00, 0x81, 1,// ACC = 0x34, nothing appended
+        SOP_READ_MEM_ACC, (uint8_t)(0x85 - 0x34), 1,   // 0x56
+        SOP_SET_COUNTER, 0x00, 0x03,
+        SOP_READ_MEM, 0x00, 0x90, 1,            // 0xAB three times
+        SOP_LOOP, (uint8_t)-6,
+        SOP_BRANCH_EQ, 0x00, 0xFF, 0x00, 0xAB, 4,  // skips the next read
+        SOP_READ_MEM, 0x00, 0x80, 1,
+        SOP_BRANCH_NE, 0x00, 0xFF, 0x00, 0xAB, 4,  // doesn't skip
+        SOP_READ_MEM, 0x00, 0x91, 1,            // 0xCD
+        SOP_DELAY_US, 0x00, 0x10,
+        SOP_END,
+    };
+    const uint8_t expected[] = { hcs08.bdcscr, 0x12, 0x34, 0x56, 0xAB, 0xAB, 0xAB, 0xCD };
+
+    _expect("valid script", script, sizeof(script), BDM_RC_OK);
+    _expect_result("valid script", expected, sizeof(expected));
+
+    if ((hcs08.memory[0x0090] != 0xAB) || (hcs08.memory[0x0091] != 0xCD))
+    {
+        printf("FAIL valid script: SOP_WRITE_MEM not written\n");
+        failures++;
+    }
+
+    const uint8_t empty[] = { SOP_END };
+
+    _expect("empty script", empty, sizeof(empty), BDM_RC_OK);
+    _expect_result("empty script", result, 0);
+}
+
+static void _test_malformed(void)
+{
+    const uint8_t no_end[]          = { SOP_SET_COUNTER, 0x00, 0x01 };
+    const uint8_t unknown[]         = { SOP_DELAY_US + 1, SOP_END };
+    const uint8_t unknown_quiet[]   = { SOP_QUIET | 0x7F, SOP_END };
+    const uint8_t truncated[]       = { SOP_READ_MEM, 0x00, 0x80 };
+    const uint8_t bdm_no_tx[]       = { SOP_BDM, 0, 1, SOP_END };
+    const uint8_t bdm_tx_too_long[] = { SOP_BDM, 5, 0, 1, 2, 3, 4, 5, SOP_END };
+    const uint8_t bdm_rx_too_long[] = { SOP_BDM, 1, 3, READ_STATUS, SOP_END };
+    const uint8_t bdm_tx_missing[]  = { SOP_BDM, 3, 0, WRITE_BKPT, 0x12 };
+    const uint8_t write_missing[]   = { SOP_WRITE_MEM, 0x00, 0x90, 4, 1, 2, 3 };
+    const uint8_t branch_before[]   = { SOP_BRANCH_EQ, 0x00, 0x00, 0x00, 0x00, (uint8_t)-7, SOP_END };
+    const uint8_t branch_after[]    = { SOP_BRANCH_EQ, 0x00, 0x00, 0x00, 0x00, 10, SOP_END };
+
+    _expect("missing SOP_END", no_end, sizeof(no_end), BDM_RC_ILLEGAL_PARAMS);
+    _expect("unknown opcode", unknown, sizeof(unknown), BDM_RC_ILLEGAL_PARAMS);
+    _expect("unknown quiet opcode", unknown_quiet, sizeof(unknown_quiet), BDM_RC_ILLEGAL_PARAMS);
+    _expect("truncated operand", truncated, sizeof(truncated), BDM_RC_ILLEGAL_PARAMS);
+    _expect("SOP_BDM without tx", bdm_no_tx, sizeof(bdm_no_tx), BDM_RC_ILLEGAL_PARAMS);
+    _expect("SOP_BDM tx > 4", bdm_tx_too_long, sizeof(bdm_tx_too_long), BDM_RC_ILLEGAL_PARAMS);
+    _expect("SOP_BDM rx > 2", bdm_rx_too_long, sizeof(bdm_rx_too_long), BDM_RC_ILLEGAL_PARAMS);
+    _expect("SOP_BDM tx past the end", bdm_tx_missing, sizeof(bdm_tx_missing), BDM_RC_ILLEGAL_PARAMS);
+    _expect("SOP_WRITE_MEM data past the end", write_missing, sizeof(write_missing), BDM_RC_ILLEGAL_PARAMS);
+    _expect("branch before the script", branch_before, sizeof(branch_before), BDM_RC_ILLEGAL_PARAMS);
+    _expect("branch after the script", branch_after, sizeof(branch_after), BDM_RC_ILLEGAL_PARAMS);
+
+    if (hcs08.memory[0x0090] != 0xAB)
+    {
+        printf("FAIL SOP_WRITE_MEM data past the end: memory written\n");
+        failures++;
+    }
+
+    // Result buffer overflow
+    const uint8_t overflow[] = { SOP_READ_MEM, 0x00, 0x80, 8, SOP_END };
+
+    if (_run(overflow, sizeof(overflow), 4) != BDM_RC_ILLEGAL_PARAMS)
+    {
+        printf("FAIL result overflow: accepted\n");
+        failures++;
+    }
+}
+
+static void _test_budget(void)
+{
+    // Branch to itself forever: stopped after SCRIPT_MAX_STEPS operations
+    const uint8_t endless[] = { SOP_BRANCH_EQ, 0x00, 0x00, 0x00, 0x00, (uint8_t)-6, SOP_END };
+
+    _expect("endless loop", endless, sizeof(endless), BDM_RC_FAIL);
+
+    // 20 delays of 65 ms: over SCRIPT_TIMEOUT_US
+    const uint8_t long_delay[] = { SOP_SET_COUNTER, 0x00, 20, SOP_DELAY_US, 0xFF, 0xFF, SOP_LOOP, (uint8_t)-5, SOP_END };
+    sim_time_t start = sim_now;
+
+    _expect("delays over the budget", long_delay, sizeof(long_delay), BDM_RC_FAIL);
+
+    if (sim_ticks_to_us(sim_now - start) > SCRIPT_TIMEOUT_US)
+    {
+        printf("FAIL delays over the budget: ran %llu us\n", (unsigned long long)sim_ticks_to_us(sim_now - start));
+        failures++;
+    }
+}
+
+int main(void)
+{
+    uint8_t buffer[8] = { 0, CMD_USBDM_CONNECT };
+
+    set_sys_clock_pll(VCO_FREQ * MHZ, POST_DEV1, POST_DEV2);
+    sim_reset(clock_get_hz(clk_sys));
+    hcs08_init(8*MHZ);
+    bdm_pio_init();
+
+    command_exec(buffer, 2);
+    if (buffer[0] != BDM_RC_OK)
+    {
+        printf("FAIL connect\n");
+        return EXIT_FAILURE;
+    }
+
+    _test_valid();
+    _test_malformed();
+    _test_budget();
+
+    if (hcs08.protocol_errors != 0)
+    {
+        printf("FAIL target: %u protocol errors\n", hcs08.protocol_errors);
+        failures++;
+    }
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
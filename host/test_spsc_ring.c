@@ -0,0 +1,135 @@
+// spsc_ring.h: order, full/empty, index wrap, and a producer and a consumer on two threads
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "spsc_ring.h"
+
+#define RING_SIZE       8
+#define STRESS_ITEMS    200000
+
+static int failures = 0;
+
+static void _check(bool ok, const char *what)
+{
+    if (!ok)
+    {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+static void _test_single(void)
+{
+    static void * volatile slots[RING_SIZE];
+    spsc_ring_t ring = SPSC_RING_INIT(slots);
+    void *item = NULL;
+
+    _check(ring.size == RING_SIZE, "size from the slot array");
+    _check(spsc_ring_is_empty(&ring), "empty at start");
+    _check(!spsc_ring_pop(&ring, &item), "pop of an empty ring");
+    _check(!spsc_ring_peek(&ring, &item), "peek of an empty ring");
+
+    for (uintptr_t i = 1; i <= RING_SIZE; i++)
+    {
+        _check(spsc_ring_push(&ring, (void *)i), "push until full");
+    }
+    _check(spsc_ring_is_full(&ring), "full after size pushes");
+    _check(!spsc_ring_push(&ring, (void *)99), "push to a full ring");
+
+    _check(spsc_ring_peek(&ring, &item) && (item == (void *)1), "peek returns the oldest item");
+    _check(spsc_ring_is_full(&ring), "peek doesn't remove the item");
+
+    for (uintptr_t i = 1; i <= RING_SIZE; i++)
+    {
+        _check(spsc_ring_pop(&ring, &item) && (item == (void *)i), "pop in push order");
+    }
+    _check(spsc_ring_is_empty(&ring), "empty after as many pops as pushes");
+}
+
+// head and tail are free running: the ring must keep working when they wrap around 2^32
+static void _test_index_wrap(void)
+{
+    static void * volatile slots[RING_SIZE];
+    spsc_ring_t ring = SPSC_RING_INIT(slots);
+    void *item = NULL;
+
+    ring.head = ring.tail = UINT32_MAX - 2;
+
+    for (uintptr_t i = 1; i <= RING_SIZE; i++)
+    {
+        _check(spsc_ring_push(&ring, (void *)i), "push across the index wrap");
+    }
+    _check(spsc_ring_is_full(&ring), "full across the index wrap");
+    _check(!spsc_ring_push(&ring, (void *)99), "push to a full ring across the index wrap");
+
+    for (uintptr_t i = 1; i <= RING_SIZE; i++)
+    {
+        _check(spsc_ring_pop(&ring, &item) && (item == (void *)i), "pop across the index wrap");
+    }
+    _check(spsc_ring_is_empty(&ring), "empty across the index wrap");
+}
+
+// One thread per core, as usbdm.c and event.c use the rings
+static void * volatile stress_slots[RING_SIZE];
+static spsc_ring_t stress_ring = SPSC_RING_INIT(stress_slots);
+
+static void *_producer(void *arg)
+{
+    (void)arg;
+
+    for (uintptr_t i = 1; i <= STRESS_ITEMS; i++)
+    {
+        while (!spsc_ring_push(&stress_ring, (void *)i))
+        {
+            // Let the consumer run when both threads share a CPU
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static void _test_two_threads(void)
+{
+    pthread_t producer;
+    uintptr_t expected = 1;
+    void *item;
+
+    pthread_create(&producer, NULL, _producer, NULL);
+
+    while (expected <= STRESS_ITEMS)
+    {
+        if (!spsc_ring_pop(&stress_ring, &item))
+        {
+            sched_yield();
+        }
+        else if ((uintptr_t)item != expected)
+        {
+            printf("FAIL two threads: item %lu, expected %lu\n", (unsigned long)(uintptr_t)item,
+                   (unsigned long)expected);
+            failures++;
+            // Resynchronize, the producer must still be able to finish
+            expected = (uintptr_t)item + 1;
+        }
+        else
+        {
+            expected++;
+        }
+    }
+
+    pthread_join(producer, NULL);
+    _check(spsc_ring_is_empty(&stress_ring), "empty after the two threads");
+}
+
+int main(void)
+{
+    _test_single();
+    _test_index_wrap();
+    _test_two_threads();
+
+    return (failures == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -5,6 +5,7 @@
 
 #include "bsp/board.h"
 #include "tusb.h"
+#include "pico/multicore.h"
 
 #include "usb_descriptors.h"
 
@@ -40,6 +41,9 @@ int main(void)
   // Set clock and connect BDM
   device_init();
 
+  // BDM commands are executed on core 1, USB is serviced on core 0
+  multicore_launch_core1(usbdm_core1_main);
+
   while (1)
   {
     tud_task(); // tinyusb device task
@@ -75,6 +79,9 @@ void device_init(void)
 {
   // Set sys clock to 64MHz
   set_sys_clock_pll(VCO_FREQ * MHZ, POST_DEV1, POST_DEV2);
+
+  // Load BDM PIO programs once, their clock dividers depend on sys clock
+  bdm_pio_init();
 }
 
 //--------------------------------------------------------------------+
@@ -82,25 +89,29 @@ void device_init(void)
 //--------------------------------------------------------------------+
 void usbdm_task(void)
 {
-  // Check if board button is pressed
-  uint32_t const btn = board_button_read();
-
-  if (btn)
+  // Check if board button is pressed.
+  // Reading BOOTSEL disables flash access, so it is only read while core 1 is idle and running from RAM
+  if (usbdm_is_core1_idle() && board_button_read())
   {
-    // Hold BKGD pin low for 5 seconds
-    bdm_connect();
-
-    // SYNC command
-    bdm_cmd_sync();
+    // Hold BKGD pin low for 5 seconds and SYNC (on core 1)
+    usbdm_queue_connect();
   }
 
   USBDM_ErrorCode command_status;
 
-  if (tud_vendor_available())
+  // A new command is accepted once the previous one has been answered
+  if (!usbdm_is_busy() && tud_vendor_available())
   {
-    // Receive command from EP1 OUT
-    command_status = receive_USB_command();
+    // Receive command from EP1 OUT and queue it to core 1
+    receive_USB_command();
+  }
+
+  // Send the unsolicited events (e.g. target halted) on the event interface
+  usbdm_event_task();
 
+  // Send back the response of the executed command
+  if (usbdm_response_task(&command_status))
+  {
     if ((uint8_t)command_status==BDM_RC_OK)
     {
       blink_interval_ms = BLINK_COMMAND_OK;
@@ -1,11 +1,15 @@
 #include "pio_functions.h"
 #include "bdm-data.pio.h"
 #include "bdm-sync.pio.h"
-#include "hardware/claim.h"
 
 #include "config.h"
 #include "commands.h"
 
+// DMA channel feeding the bdm-data tx fifo
+static int dma_tx_chan = -1;
+// DMA channel draining the bdm-data rx fifo
+static int dma_rx_chan = -1;
+
 // Utils------------------------------------------------------
 void measure_freqs(void) {
     uint f_pll_sys = frequency_count_khz(CLOCKS_FC0_SRC_VALUE_PLL_SYS_CLKSRC_PRIMARY);
@@ -73,43 +77,21 @@ void put_tx_fifo(PIO pio, uint sm, uint data, uint bit, bool shift_right)
 }
 
 
-void wait_end_operation(PIO pio, uint sm)
+bool wait_end_operation(PIO pio, uint sm, uint32_t timeout_us)
 {
+    absolute_time_t deadline = make_timeout_time_us(timeout_us);
+
     // Wait for an operation to complete. 
     // When any operation ends, some data are transferred to rx fifo
-    while(pio_sm_is_rx_fifo_empty(pio, sm));
-}
-
-uint pio_program_init(PIO pio, uint sm, const struct pio_program *pio_prog)
-{
-    // Stop running PIO program in the state machine
-    pio_sm_set_enabled(pio, sm, false);
-
-    // Clear instruction memory
-    pio_clear_instruction_memory(pio);
-
-    // Add PIO program to PIO instruction memory, SDK will find location and
-    // return with the memory offset of the program.
-    uint offset = pio_add_program(pio, pio_prog);
-
-    // Clear eventual data in rx and tx fifos
-    pio_sm_clear_fifos(pio, sm);
-
-    return offset;
-}
+    while(pio_sm_is_rx_fifo_empty(pio, sm))
+    {
+        if (time_reached(deadline))
+        {
+            return false;
+        }
+    }
 
-void pio_add_instr(PIO pio, uint instr, uint offset)
-{
-    uint32_t save = hw_claim_lock();
-    pio->instr_mem[offset] = instr;
-    hw_claim_unlock(save);
-}
-
-
-void pio_set_pull_threshold(PIO pio, uint sm, uint pull_threshold)
-{
-    pio->sm[sm].shiftctrl = (pio->sm[sm].shiftctrl & ~(0x3e000000)) |
-                            ((pull_threshold & 0x1fu) << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB);
+    return true;
 }
 
 // Actual commands---------------------------------------------------------------
@@ -138,8 +120,9 @@ void bdm_connect(void)
 // Init bdm
 uint bdm_init(PIO pio, uint sm, float pio_freq)
 {
-    // Clear memory and fifos and add program
-    uint offset = pio_program_init(pio, sm, &bdm_data_program);
+    // Add PIO program to PIO instruction memory, SDK will find location and
+    // return with the memory offset of the program.
+    uint offset = pio_add_program(pio, &bdm_data_program);
 
     // Calculate the PIO clock divider 
     float div = get_pio_clk_div(pio_freq);
@@ -152,39 +135,269 @@ uint bdm_init(PIO pio, uint sm, float pio_freq)
     return offset;
 }
 
+// Change bdm-data clock
+void bdm_set_clkdiv(PIO pio, uint sm, uint32_t div_256)
+{
+    // Divider must be in [1, 65536)
+    if (div_256 < 0x100)
+    {
+        div_256 = 0x100;
+    }
+    if (div_256 > 0xFFFFFF)
+    {
+        div_256 = 0xFFFFFF;
+    }
+
+    // The state machine is stalled on "pull" between bursts, so the divider can be changed on the fly
+    pio_sm_set_clkdiv_int_frac(pio, sm, (uint16_t)(div_256>>8), (uint8_t)(div_256&0xFF));
+}
 
-// Data command
-void do_bdm_command(PIO pio, uint sm, uint data, uint tx_bit, uint rx_bit, uint offset)
+
+//! Build the header word of a bdm-data frame
+//!
+//! @param tx_bit   : number of bit to transmit (1 to 32)
+//! @param rx_bit   : number of bit to receive (can be zero)
+//! @param no_delay    : true if the command has no delay between tx and rx
+//! @param ack_timeout : loops of 2 BDC cycles to wait for the ACK pulse (0 to use the fixed delay)
+//!
+//! @note
+//!     See bdm-data.pio for the frame format
+//!
+uint bdm_frame_header(uint tx_bit, uint rx_bit, bool no_delay, uint ack_timeout)
 {
-    // Set number of bit to shift out by changing pull threshold
-    pio_set_pull_threshold(pio, sm, tx_bit);
+    uint header = ((tx_bit-1)<<24) | (rx_bit<<16) | ((no_delay ? 1u : 0u)<<15);
 
-    // Set number of bit to shift in by encoding a "set x, rx_bit" instruction in pio instr memory
-    uint instr = pio_encode_set(pio_x, rx_bit);
-    pio_add_instr(pio, instr, offset + 1);
+    if (ack_timeout > 0)
+    {
+        header |= (1u<<14) | (ack_timeout & 0x3FFF);
+    }
+
+    return header;
+}
+
+//! Wire time of a frame, as executed by bdm-data.pio
+//!
+//! @param header : frame header, see bdm_frame_header()
+//!
+//! @return number of PIO cycles (= BDC cycles) from the header pull to the push of the result
+//!
+//! @note
+//!   With ACK the target is assumed to start its pulse 16 cycles after the command and to hold
+//!   it for 16 cycles, as on HCS08. Slower targets (e.g. flash busy) take longer.
+//!
+uint bdm_frame_cycles(uint header)
+{
+    uint tx_bit = (header>>24) + 1;
+    uint rx_bit = (header>>16) & 0xFF;
+    uint gap;
+
+    if (header & (1u<<15))
+    {
+        // mov, mov, out, jmp, jmp y-- (rx_start)
+        gap = 5;
+    }
+    else if (header & (1u<<14))
+    {
+        // Pin released 8 cycles after tx, end of the pulse seen within one loop of 2 cycles, jmp y-- (rx_start)
+        gap = BDM_ACK_START_CYCLES + BDM_ACK_PULSE_CYCLES + 2 + 1;
+    }
+    else
+    {
+        gap = BDM_DELAY_CYCLES;
+    }
 
-    // Put data in tx fifo:
-    put_tx_fifo(pio, sm, data, tx_bit, SHIFT_RIGHT);
+    // pull, out, out, mov, pull, set + bits + push (jmp end, push if nothing is received)
+    return 6 + BDM_BIT_CYCLES*tx_bit + gap + BDM_BIT_CYCLES*rx_bit + (rx_bit ? 1 : 2);
 }
 
+//! Longest wire time of a frame: the target takes the whole ACK timeout
+//!
+//! @param header : frame header, see bdm_frame_header()
+//!
+//! @return number of PIO cycles (= BDC cycles)
+//!
+uint bdm_frame_max_cycles(uint header)
+{
+    uint cycles = bdm_frame_cycles(header);
 
-// Sync
-uint sync(PIO pio, uint sm, float pio_freq)
+    if (!(header & (1u<<15)) && (header & (1u<<14)))
+    {
+        // Loops of 2 cycles waiting for the ACK pulse
+        cycles += 2*(header & 0x3FFF);
+    }
+
+    return cycles;
+}
+
+//! Wire time of a burst of frames
+//!
+//! @param frames : header and data word of each frame
+//! @param count  : number of frames
+//!
+//! @return number of PIO cycles (= BDC cycles)
+//!
+uint bdm_burst_cycles(const uint *frames, uint count)
 {
-    // Clear memory and fifos and add program
-    uint offset = pio_program_init(pio, sm, &bdm_sync_program);
+    uint cycles = 0;
 
-    // Calculate the PIO clock divider 
-    float div = get_pio_clk_div(pio_freq);
+    for (uint i = 0; i < count; i++)
+    {
+        cycles += bdm_frame_cycles(frames[2*i]);
+    }
+
+    return cycles;
+}
+
+//! Longest wire time of a burst of frames, see bdm_frame_max_cycles()
+//!
+uint bdm_burst_max_cycles(const uint *frames, uint count)
+{
+    uint cycles = 0;
+
+    for (uint i = 0; i < count; i++)
+    {
+        cycles += bdm_frame_max_cycles(frames[2*i]);
+    }
+
+    return cycles;
+}
+
+void bdm_dma_init(void)
+{
+    if (dma_tx_chan < 0)
+    {
+        dma_tx_chan = dma_claim_unused_channel(true);
+        dma_rx_chan = dma_claim_unused_channel(true);
+    }
+}
+
+//! Start a burst of frames
+//!
+//! @param frames    : header and data word of each frame
+//! @param count     : number of frames
+//! @param rx        : destination of received data (NULL to discard it)
+//! @param rx_size   : size of each received element (DMA_SIZE_8 or DMA_SIZE_32)
+//!
+//! @note
+//!     Every frame pushes exactly one word in the rx fifo (dummy bits when nothing is received),
+//!     so the rx channel completes when the last frame has been executed.
+//!
+void do_bdm_burst(PIO pio, uint sm, const uint *frames, uint count, void *rx, enum dma_channel_transfer_size rx_size)
+{
+    static uint32_t rx_discard;
+
+    // Arm the rx channel first, so no word is left in the fifo
+    dma_channel_config c = dma_channel_get_default_config(dma_rx_chan);
+    channel_config_set_transfer_data_size(&c, rx_size);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, rx != NULL);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, false));
+    dma_channel_configure(dma_rx_chan, &c, (rx != NULL) ? rx : &rx_discard, &pio->rxf[sm], count, true);
+
+    c = dma_channel_get_default_config(dma_tx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(dma_tx_chan, &c, &pio->txf[sm], frames, 2*count, true);
+}
+
+//! Wait until every frame of the burst has been executed
+//!
+//! @param timeout_us : max time for the burst
+//!
+//! @return false if the burst didn't end in time. Both DMA channels are then aborted,
+//!         the state machine has to be restarted (see bdm_restart)
+//!
+bool wait_end_burst(uint32_t timeout_us)
+{
+    absolute_time_t deadline = make_timeout_time_us(timeout_us);
+
+    while (dma_channel_is_busy(dma_rx_chan))
+    {
+        if (time_reached(deadline))
+        {
+            dma_channel_abort(dma_tx_chan);
+            dma_channel_abort(dma_rx_chan);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+//! Restart bdm-data.pio from the beginning, after an aborted burst
+//!
+//! @note
+//!     The fifos are cleared and the pin is released. The clock divider is kept.
+//!
+void bdm_restart(PIO pio, uint sm, uint offset)
+{
+    pio_sm_set_enabled(pio, sm, false);
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_set_consecutive_pindirs(pio, sm, DATA_PIN, 1, false);
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset));
+    pio_sm_set_enabled(pio, sm, true);
+}
+
+
+// Init sync
+uint sync_init(PIO pio, uint sm)
+{
+    uint offset = pio_add_program(pio, &bdm_sync_program);
 
     // Initialize the program using the helper function in our .pio file
-    bdm_sync_program_init(pio, sm, offset, DATA_PIN, div);
+    bdm_sync_program_init(pio, sm, offset, DATA_PIN);
+
+    return offset;
+}
+
+//! Sync
+//!
+//! @param low_cycles : system clock cycles to hold BKGD low
+//! @param timeout    : max loops of 2 system clock cycles to wait for the start and for the end of the target response
+//!
+//! @return
+//!     length of the target response in loops of 2 system clock cycles, 0 if the target didn't answer
+//!
+uint sync(PIO pio, uint sm, uint offset, uint low_cycles, uint timeout)
+{
+    // Restart bdm-sync PIO program from the beginning
+    pio_sm_set_enabled(pio, sm, false);
+    pio_sm_clear_fifos(pio, sm);
+    pio_sm_restart(pio, sm);
+    pio_sm_exec(pio, sm, pio_encode_jmp(offset));
+
+    // Parameters of the program
+    pio_sm_put(pio, sm, low_cycles - 1);
+    pio_sm_put(pio, sm, timeout);
+
+    // Give the pin to this PIO
+    pio_gpio_init(pio, DATA_PIN);
 
     // Start running bdm-sync PIO program in the state machine
     pio_sm_set_enabled(pio, sm, true);
 
-    // Wait for the sm to push data in rx fifo
-    uint ticks = pio_sm_get_blocking(pio, sm);
+    // The program always ends within its timeouts: low time, then two waits of 2 cycles per loop.
+    // The CPU wait is bounded anyway, in case the state machine doesn't run as expected.
+    uint32_t sys_mhz = clock_get_hz(clk_sys) / MHZ;
+    uint64_t max_us  = ((uint64_t)low_cycles + 4ull*timeout) / sys_mhz + SYNC_MARGIN_US;
+
+    if (!wait_end_operation(pio, sm, (uint32_t)max_us))
+    {
+        pio_sm_set_enabled(pio, sm, false);
+        return 0;
+    }
+
+    uint y = pio_sm_get(pio, sm);
+
+    pio_sm_set_enabled(pio, sm, false);
+
+    if (y == 0xFFFFFFFF)
+    {
+        return 0;
+    }
 
-    return ticks;
+    return timeout - y;
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "hardware/structs/pll.h"
 #include "hardware/structs/clocks.h"
 #include "hardware/pio.h"
+#include "hardware/dma.h"
 
 // Define the time(in ms) to wait for a CDC connection to be established.
 // This prevent initial program output being lost, at cost of requiring an active CDC connection
@@ -31,26 +32,52 @@ void put_tx_fifo(PIO pio, uint sm, uint data, uint bit, bool shift_right);
 // Put data in TX FIFO
 void fill_tx_fifo(PIO pio, uint sm, uint *data, uint length, uint bit, bool shift_right);
 
-// Wait until some data are received on rx fifo
-void wait_end_operation(PIO pio, uint sm);
-
-// Stop running sm, clear instruction memory, clear fifos and add new program. Return offset
-uint pio_program_init(PIO pio, uint sm, const struct pio_program *pio_prog);
-
-// Replace an instruction at offset pio instruction memory location
-void pio_add_instr(PIO pio, uint instr, uint offset);
-
-// Set pull threshold
-void pio_set_pull_threshold(PIO pio, uint sm, uint pull_threshold);
+// Wait until some data are received on rx fifo. Return false on timeout
+bool wait_end_operation(PIO pio, uint sm, uint32_t timeout_us);
 
 // Set the line low for 5 seconds, so the MCU can enter active background mode
 void bdm_connect(void);
 
-// Init bdm by setting up bdm-data.pio program in pio instruction memory
+// Load bdm-data.pio program in pio instruction memory and start the state machine. Return offset
 uint bdm_init(PIO pio, uint sm, float pio_freq);
 
-// Transmit a bdm command and eventual data
-void do_bdm_command(PIO pio, uint sm, uint data, uint tx_bit, uint rx_bit, uint offset);
+// Change the clock divider (16.8 fixed point) of the bdm-data state machine
+void bdm_set_clkdiv(PIO pio, uint sm, uint32_t div_256);
+
+
+// Build the header word of a bdm-data frame
+uint bdm_frame_header(uint tx_bit, uint rx_bit, bool no_delay, uint ack_timeout);
+
+// Timing of bdm-data.pio, in PIO cycles (1 PIO cycle = 1 BDC cycle)
+#define BDM_BIT_CYCLES        16    // One bit, transmitted or received
+#define BDM_DELAY_CYCLES      15    // Fixed delay between tx and rx (WAIT), 16 to the first rx falling edge
+#define BDM_ACK_START_CYCLES  16    // Start of the target ACK pulse after the command
+#define BDM_ACK_PULSE_CYCLES  16    // Length of the target ACK pulse
+
+// Wire time of a frame in PIO cycles, from its header
+uint bdm_frame_cycles(uint header);
+
+// Wire time of a burst of frames in PIO cycles
+uint bdm_burst_cycles(const uint *frames, uint count);
+
+// Longest wire time (whole ACK timeouts) of a frame and of a burst, in PIO cycles
+uint bdm_frame_max_cycles(uint header);
+uint bdm_burst_max_cycles(const uint *frames, uint count);
+
+// Claim the DMA channels that feed and drain the bdm-data state machine
+void bdm_dma_init(void);
+
+// Start a burst of frames: one DMA channel feeds the tx fifo, the other drains the rx fifo
+void do_bdm_burst(PIO pio, uint sm, const uint *frames, uint count, void *rx, enum dma_channel_transfer_size rx_size);
+
+// Wait until every frame of the burst has been executed. Return false on timeout (DMA aborted)
+bool wait_end_burst(uint32_t timeout_us);
+
+// Restart bdm-data.pio after an aborted burst
+void bdm_restart(PIO pio, uint sm, uint offset);
+
+// Load bdm-sync.pio program in pio instruction memory and configure the state machine. Return offset
+uint sync_init(PIO pio, uint sm);
 
-// Do the SYNC command
-uint sync(PIO pio, uint sm, float pio_freq);
\ No newline at end of file
+// Do the SYNC command. Return the length of the target response in loops of 2 system clock cycles (0 = no response)
+uint sync(PIO pio, uint sm, uint offset, uint low_cycles, uint timeout);
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "script.h"
+
+#include <string.h>
+
+#include "config.h"
+
+#include "bdm.h"
+
+// Big endian 16-bit operand
+static inline uint16_t _get16(const uint8_t *ptr)
+{
+    return (uint16_t)((ptr[0]<<8) | ptr[1]);
+}
+
+//! Execute a script
+//!
+//! @param script      : byte-coded operations, see script.h
+//! @param script_size : size of the script
+//! @param result_ptr  : result buffer
+//! @param result_max  : size of the result buffer
+//! @param result_size : number of bytes appended to the result buffer
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success                                   \n
+//!    == \ref BDM_RC_ILLEGAL_PARAMS => malformed script or result buffer overflow \n
+//!    == \ref BDM_RC_FAIL => the script executed more than SCRIPT_MAX_STEPS operations,
+//!                           or ran longer than SCRIPT_TIMEOUT_US \n
+//!    other => BDM error, the script stops at the failed operation
+//!
+uint8_t script_exec(const uint8_t *script, uint script_size, uint8_t *result_ptr, uint result_max, uint *result_size)
+{
+    // Operand size of each opcode (SOP_BDM and SOP_WRITE_MEM have extra bytes)
+    static const uint8_t operand_size[] = {
+        [SOP_END]           = 0,
+        [SOP_BDM]           = 2,
+        [SOP_READ_MEM]      = 3,
+        [SOP_READ_MEM_ACC]  = 2,
+        [SOP_WRITE_MEM]     = 3,
+        [SOP_SET_COUNTER]   = 2,
+        [SOP_LOOP]          = 1,
+        [SOP_BRANCH_EQ]     = 5,
+        [SOP_BRANCH_NE]     = 5,
+        [SOP_DELAY_US]      = 2,
+    };
+
+    uint8_t  scratch[MAX_BDM_FRAMES];
+    uint     pc = 0;
+    uint     result_count = 0;
+    uint16_t acc = 0;
+    uint16_t counter = 0;
+    absolute_time_t timeout = make_timeout_time_us(SCRIPT_TIMEOUT_US);
+
+    *result_size = 0;
+
+    for (uint steps = 0; steps < SCRIPT_MAX_STEPS; steps++)
+    {
+        if (time_reached(timeout))
+        {
+            return BDM_RC_FAIL;
+        }
+        if (pc >= script_size)
+        {
+            // Missing SOP_END
+            return BDM_RC_ILLEGAL_PARAMS;
+        }
+
+        uint8_t opcode = script[pc] & ~SOP_QUIET;
+        bool    is_quiet = (script[pc] & SOP_QUIET) != 0;
+
+        if ((opcode >= sizeof(operand_size)) || (pc + 1 + operand_size[opcode] > script_size))
+        {
+            return BDM_RC_ILLEGAL_PARAMS;
+        }
+
+        const uint8_t *operand = script + pc + 1;
+        uint next_pc = pc + 1 + operand_size[opcode];
+        int  branch = 0;
+
+        // Values read by the operation
+        uint8_t *read_ptr = NULL;
+        uint     read_count = 0;
+
+        switch (opcode)
+        {
+            case SOP_END:
+            {
+                *result_size = result_count;
+                return BDM_RC_OK;
+            }
+            case SOP_BDM:
+            {
+                uint8_t tx_count = operand[0];
+                uint8_t rx_count = operand[1];
+
+                if ((tx_count < 1) || (tx_count > 4) || (rx_count > 2) || (next_pc + tx_count > script_size))
+                {
+                    return BDM_RC_ILLEGAL_PARAMS;
+                }
+
+                uint received_data = 0;
+                uint8_t rc = bdm_cmd_raw(operand+2, tx_count, rx_count, &received_data);
+
+                if (rc != BDM_RC_OK)
+                {
+                    return rc;
+                }
+                next_pc += tx_count;
+
+                acc = (uint16_t)received_data;
+
+                // Big endian
+                scratch[0] = (uint8_t)(received_data>>8);
+                scratch[1] = (uint8_t)received_data;
+                read_ptr   = scratch + 2 - rx_count;
+                read_count = rx_count;
+                break;
+            }
+            case SOP_READ_MEM:
+            case SOP_READ_MEM_ACC:
+            {
+                uint16_t addr  = (opcode == SOP_READ_MEM) ? _get16(operand) : (uint16_t)(acc + (int8_t)operand[0]);
+                uint8_t  count = (opcode == SOP_READ_MEM) ? operand[2] : operand[1];
+
+                if (count == 0)
+                {
+                    break;
+                }
+
+                uint8_t rc = bdm_cmd_read_bytes(addr, count, scratch);
+
+                if (rc != BDM_RC_OK)
+                {
+                    return rc;
+                }
+
+                acc = scratch[count-1];
+                read_ptr   = scratch;
+                read_count = count;
+                break;
+            }
+            case SOP_WRITE_MEM:
+            {
+                uint8_t count = operand[2];
+
+                if (next_pc + count > script_size)
+                {
+                    return BDM_RC_ILLEGAL_PARAMS;
+                }
+
+                uint8_t rc = bdm_cmd_write_bytes(_get16(operand), count, operand+3);
+
+                if (rc != BDM_RC_OK)
+                {
+                    return rc;
+                }
+                next_pc += count;
+                break;
+            }
+            case SOP_SET_COUNTER:
+            {
+                counter = _get16(operand);
+                break;
+            }
+            case SOP_LOOP:
+            {
+                if (--counter != 0)
+                {
+                    branch = (int8_t)operand[0];
+                }
+                break;
+            }
+            case SOP_BRANCH_EQ:
+            case SOP_BRANCH_NE:
+            {
+                bool is_equal = (acc & _get16(operand)) == _get16(operand+2);
+
+                if (is_equal == (opcode == SOP_BRANCH_EQ))
+                {
+                    branch = (int8_t)operand[4];
+                }
+                break;
+            }
+            case SOP_DELAY_US:
+            {
+                absolute_time_t delay_end = make_timeout_time_us(_get16(operand));
+
+                if (absolute_time_diff_us(delay_end, timeout) < 0)
+                {
+                    // Don't wait for a delay that ends after the budget
+                    return BDM_RC_FAIL;
+                }
+                sleep_until(delay_end);
+                break;
+            }
+        }
+
+        if (!is_quiet && (read_count > 0))
+        {
+            if (result_count + read_count > result_max)
+            {
+                return BDM_RC_ILLEGAL_PARAMS;
+            }
+
+            memcpy(result_ptr + result_count, read_ptr, read_count);
+            result_count += read_count;
+        }
+
+        if (((int)next_pc + branch < 0))
+        {
+            return BDM_RC_ILLEGAL_PARAMS;
+        }
+
+        pc = (uint)((int)next_pc + branch);
+    }
+
+    return BDM_RC_FAIL;
+}
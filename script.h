@@ -0,0 +1,50 @@
+#ifndef SCRIPT_H_
+#define SCRIPT_H_
+
+#include "pico/stdlib.h"
+
+//--------------------------------------------------------------------+
+// BDM SCRIPTS
+//--------------------------------------------------------------------+
+// A script is a sequence of byte-coded operations executed on the probe.
+// Values read from the target are appended to the result buffer and the
+// last one is kept in a 16-bit accumulator (ACC), used by branches and
+// indirect memory reads. 16-bit operands are big endian, branch offsets
+// are signed and relative to the next operation.
+//
+//   Opcode                Operands                    Action
+//   SOP_END               -                           End of script
+//   SOP_BDM               tx, rx, tx bytes            BDM command (tx 1..4 bytes, rx 0..2 bytes), ACC = received data
+//   SOP_READ_MEM          addr16, count               Read memory (READ_BYTE), ACC = last byte
+//   SOP_READ_MEM_ACC      offset8, count              Read memory at ACC+offset
+//   SOP_WRITE_MEM         addr16, count, data bytes   Write memory (WRITE_BYTE)
+//   SOP_SET_COUNTER       count16                     Load the loop counter
+//   SOP_LOOP              offset8                     Decrement the counter, branch if not zero
+//   SOP_BRANCH_EQ         mask16, value16, offset8    Branch if (ACC & mask) == value
+//   SOP_BRANCH_NE         mask16, value16, offset8    Branch if (ACC & mask) != value
+//   SOP_DELAY_US          time16                      Wait
+//
+// SOP_QUIET can be or-ed with SOP_BDM/SOP_READ_MEM/SOP_READ_MEM_ACC to update ACC
+// without appending to the result buffer (e.g. in polling loops).
+//
+typedef enum {
+   SOP_END            = 0x00,
+   SOP_BDM            = 0x01,
+   SOP_READ_MEM       = 0x02,
+   SOP_READ_MEM_ACC   = 0x03,
+   SOP_WRITE_MEM      = 0x04,
+   SOP_SET_COUNTER    = 0x05,
+   SOP_LOOP           = 0x06,
+   SOP_BRANCH_EQ      = 0x07,
+   SOP_BRANCH_NE      = 0x08,
+   SOP_DELAY_US       = 0x09,
+
+   SOP_QUIET          = 0x80,
+} ScriptOpcode_t;
+
+#define SCRIPT_MAX_STEPS    100000  // Max number of operations executed by a script (endless loops)
+#define SCRIPT_TIMEOUT_US   1000000 // Max execution time of a script, delays included
+
+uint8_t script_exec(const uint8_t *script, uint script_size, uint8_t *result_ptr, uint result_max, uint *result_size);
+
+#endif /* SCRIPT_H_ */
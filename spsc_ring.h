@@ -0,0 +1,92 @@
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+
+//--------------------------------------------------------------------+
+// Lock-free single-producer/single-consumer ring of pointers.
+// One core pushes, the other core pops: head is only written by the
+// producer, tail only by the consumer.
+// Functions are forced inline, so they can be used by code running from RAM.
+// Each ring has its own slot array, see SPSC_RING_INIT.
+//--------------------------------------------------------------------+
+
+typedef struct {
+   volatile uint32_t head;                  //!< Next slot to write (producer)
+   volatile uint32_t tail;                  //!< Next slot to read (consumer)
+   uint32_t          size;                  //!< Number of slots (power of 2)
+   void * volatile  *slots;
+} spsc_ring_t;
+
+// Initializer of a ring using a slot array: void * volatile slots[size], size a power of 2
+#define SPSC_RING_INIT(slot_array)  { 0, 0, count_of(slot_array), (slot_array) }
+
+// Push an item. Return false if the ring is full
+static __force_inline bool spsc_ring_push(spsc_ring_t *ring, void *item)
+{
+   uint32_t head = ring->head;
+
+   if (head - ring->tail == ring->size)
+   {
+      return false;
+   }
+
+   ring->slots[head & (ring->size-1)] = item;
+
+   // Slot must be written before it is published
+   __dmb();
+   ring->head = head + 1;
+
+   return true;
+}
+
+// Pop an item. Return false if the ring is empty
+static __force_inline bool spsc_ring_pop(spsc_ring_t *ring, void **item)
+{
+   uint32_t tail = ring->tail;
+
+   if (ring->head == tail)
+   {
+      return false;
+   }
+
+   // Slot must be read after head has been seen
+   __dmb();
+   *item = ring->slots[tail & (ring->size-1)];
+
+   __dmb();
+   ring->tail = tail + 1;
+
+   return true;
+}
+
+// Read the oldest item without removing it. Return false if the ring is empty
+static __force_inline bool spsc_ring_peek(spsc_ring_t *ring, void **item)
+{
+   uint32_t tail = ring->tail;
+
+   if (ring->head == tail)
+   {
+      return false;
+   }
+
+   __dmb();
+   *item = ring->slots[tail & (ring->size-1)];
+
+   return true;
+}
+
+// Return true if the ring is full
+static __force_inline bool spsc_ring_is_full(spsc_ring_t *ring)
+{
+   return ring->head - ring->tail == ring->size;
+}
+
+// Return true if the ring is empty
+static __force_inline bool spsc_ring_is_empty(spsc_ring_t *ring)
+{
+   return ring->head == ring->tail;
+}
+
+#endif /* SPSC_RING_H_ */
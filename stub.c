@@ -0,0 +1,163 @@
+#include "stub.h"
+
+#include "config.h"
+#include "BDM_options.h"
+
+#include "bdm.h"
+
+// Stub set up by the host?
+static bool is_stub_setup = false;
+// Stub is running on the target and its result hasn't been collected yet?
+static bool is_stub_running = false;
+// Result code (A) of the last run
+static uint8_t last_result = 0;
+
+// Stub entry point, stack and parameter block addresses in target RAM
+static uint16_t stub_entry;
+static uint16_t stub_sp;
+static uint16_t stub_param;
+// Page buffers in target RAM
+static uint16_t stub_buffers[STUB_BUFFERS];
+static uint8_t  stub_buffer_size;
+// Next page buffer to fill
+static uint8_t  next_buffer = 0;
+
+//! Set up the stub
+//!
+//! @param entry       : address of the first stub instruction
+//! @param sp          : stack pointer while the stub runs
+//! @param param       : address of the parameter block
+//! @param buffers     : addresses of the STUB_BUFFERS page buffers
+//! @param buffer_size : size of each page buffer
+//!
+void stub_setup(uint16_t entry, uint16_t sp, uint16_t param, const uint16_t *buffers, uint8_t buffer_size)
+{
+  stub_entry       = entry;
+  stub_sp          = sp;
+  stub_param       = param;
+  stub_buffer_size = buffer_size;
+
+  for (int i=0; i<STUB_BUFFERS; i++)
+  {
+    stub_buffers[i] = buffers[i];
+  }
+
+  next_buffer     = 0;
+  last_result     = 0;
+  is_stub_running = false;
+  is_stub_setup   = true;
+}
+
+//! Wait for the stub to return to active background mode and collect its result
+//!
+//! @param result : result code (A) of the last run
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success (the stub may have failed, see result)    \n
+//!    == \ref BDM_RC_TARGET_BUSY => the stub didn't return in STUB_TIMEOUT_US \n
+//!    other => BDM error
+//!
+uint8_t stub_wait(uint8_t *result)
+{
+  if (is_stub_running)
+  {
+    absolute_time_t timeout = make_timeout_time_us(STUB_TIMEOUT_US);
+
+    uint8_t status;
+    uint8_t rc;
+
+    // The stub ends with BGND
+    while ((rc = bdm_get_status(&status)) == BDM_RC_OK)
+    {
+      if (status & HCS_BDCSCR_BDMACT)
+      {
+        break;
+      }
+      if (time_reached(timeout))
+      {
+        return BDM_RC_TARGET_BUSY;
+      }
+    }
+
+    if (rc == BDM_RC_OK)
+    {
+      rc = bdm_get_a(&last_result);
+    }
+    if (rc != BDM_RC_OK)
+    {
+      return rc;
+    }
+    is_stub_running = false;
+  }
+
+  *result = last_result;
+
+  return BDM_RC_OK;
+}
+
+//! Program a page with the stub
+//!
+//! @param addr     : flash address of the page
+//! @param count    : # of bytes
+//! @param data_ptr : page data
+//!
+//! @return
+//!    == \ref BDM_RC_OK => the page is being programmed     \n
+//!    != \ref BDM_RC_OK => error (previous page included)
+//!
+//! @note
+//!     Returns as soon as the stub has been started, so the next page can be received
+//!     while this one is programmed. The page is written with WRITE_BYTE, which doesn't
+//!     stop the target, while the stub is still programming the previous page.
+//!
+uint8_t stub_program(uint16_t addr, uint8_t count, const uint8_t *data_ptr)
+{
+  if (!is_stub_setup || (count == 0) || (count > stub_buffer_size))
+  {
+    return BDM_RC_ILLEGAL_PARAMS;
+  }
+
+  uint16_t buffer = stub_buffers[next_buffer];
+
+  // Fill the free buffer
+  uint8_t rc = bdm_cmd_write_bytes(buffer, count, data_ptr);
+
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+
+  // Previous page must be done before the parameter block is reused
+  uint8_t result;
+  rc = stub_wait(&result);
+
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+  if (result != 0)
+  {
+    return BDM_RC_FAIL;
+  }
+
+  uint8_t param_block[STUB_PARAM_SIZE] = {
+    (uint8_t)(addr>>8),   (uint8_t)addr,
+    (uint8_t)(buffer>>8), (uint8_t)buffer,
+    count,
+  };
+  rc = bdm_cmd_write_bytes(stub_param, STUB_PARAM_SIZE, param_block);
+
+  if (rc == BDM_RC_OK)
+  {
+    rc = bdm_cmd_run(stub_entry, stub_param, stub_sp);
+  }
+  if (rc != BDM_RC_OK)
+  {
+    return rc;
+  }
+  is_stub_running = true;
+
+  next_buffer = (next_buffer + 1) % STUB_BUFFERS;
+
+  return BDM_RC_OK;
+}
@@ -0,0 +1,28 @@
+#ifndef STUB_H_
+#define STUB_H_
+
+#include "pico/stdlib.h"
+
+//--------------------------------------------------------------------+
+// TARGET RAM STUB
+//--------------------------------------------------------------------+
+// A programming stub is downloaded by the host into target RAM (WRITE_MEM),
+// then the probe runs it once per page.
+//
+// Stub convention:
+//   - Entry with HX = address of the parameter block (see below)
+//   - Ends with BGND, A = result code (0 = success)
+//
+// Parameter block
+//   [0..1] = flash address of the page
+//   [2..3] = address of the RAM buffer holding the page
+//   [4]    = # of bytes
+//
+#define STUB_PARAM_SIZE     5
+#define STUB_BUFFERS        2       // Page buffers in target RAM: one is filled while the stub programs the other
+
+void stub_setup(uint16_t entry, uint16_t sp, uint16_t param, const uint16_t *buffers, uint8_t buffer_size);
+uint8_t stub_program(uint16_t addr, uint8_t count, const uint8_t *data_ptr);
+uint8_t stub_wait(uint8_t *result);
+
+#endif /* STUB_H_ */
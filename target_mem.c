@@ -0,0 +1,237 @@
+#include "target_mem.h"
+
+#include "config.h"
+#include "BDM_options.h"
+
+#include "bdm.h"
+
+// CRC32 (IEEE 802.3, reflected) lookup table, built on first use
+static uint32_t crc_table[256];
+static bool is_crc_table_init = false;
+
+static void _crc_table_init(void)
+{
+    for (uint32_t i=0; i<256; i++)
+    {
+        uint32_t crc = i;
+
+        for (int bit=0; bit<8; bit++)
+        {
+            crc = (crc & 1) ? (crc>>1) ^ 0xEDB88320 : (crc>>1);
+        }
+
+        crc_table[i] = crc;
+    }
+
+    is_crc_table_init = true;
+}
+
+//! Check that the target is in active background mode, as READ_NEXT/WRITE_NEXT need it
+//!
+//! @return
+//!    == \ref BDM_RC_OK => target halted       \n
+//!    == \ref BDM_RC_TARGET_BUSY => target running \n
+//!    other => BDM error
+//!
+static uint8_t _check_halted(void)
+{
+    uint8_t status;
+    uint8_t rc = bdm_get_status(&status);
+
+    if ((rc == BDM_RC_OK) && ((status & HCS_BDCSCR_BDMACT) == 0))
+    {
+        return BDM_RC_TARGET_BUSY;
+    }
+
+    return rc;
+}
+
+//! CRC32 of a target memory range
+//!
+//! @param addr   : address of the first byte
+//! @param length : number of bytes (addr+length must not exceed 0x10000)
+//! @param crc    : CRC32 (same as zlib crc32())
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _check_halted() and bdm_cmd_read_block()
+//!
+uint8_t target_mem_crc32(uint16_t addr, uint32_t length, uint32_t *crc)
+{
+    uint8_t  chunk[TARGET_MEM_CHUNK];
+    uint32_t value = 0xFFFFFFFF;
+    uint8_t  rc = _check_halted();
+
+    if (!is_crc_table_init)
+    {
+        _crc_table_init();
+    }
+
+    while ((length > 0) && (rc == BDM_RC_OK))
+    {
+        uint8_t count = (length > TARGET_MEM_CHUNK) ? TARGET_MEM_CHUNK : (uint8_t)length;
+
+        rc = bdm_cmd_read_block(addr, count, chunk);
+
+        for (int i=0; i<count; i++)
+        {
+            value = crc_table[(value ^ chunk[i]) & 0xFF] ^ (value>>8);
+        }
+
+        addr   += count;
+        length -= count;
+    }
+
+    *crc = ~value;
+
+    return rc;
+}
+
+//! Compare a target memory range against a buffer
+//!
+//! @param addr          : address of the first byte
+//! @param count         : number of bytes (addr+count must not exceed 0x10000)
+//! @param data_ptr      : expected bytes
+//! @param is_match      : true if the whole range matches
+//! @param mismatch_addr : address of the first byte that doesn't match
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _check_halted() and bdm_cmd_read_block()
+//!
+uint8_t target_mem_verify(uint16_t addr, uint32_t count, const uint8_t *data_ptr, bool *is_match, uint16_t *mismatch_addr)
+{
+    uint8_t chunk[TARGET_MEM_CHUNK];
+    uint8_t rc = _check_halted();
+
+    *is_match = true;
+
+    while ((count > 0) && (rc == BDM_RC_OK))
+    {
+        uint8_t size = (count > TARGET_MEM_CHUNK) ? TARGET_MEM_CHUNK : (uint8_t)count;
+
+        rc = bdm_cmd_read_block(addr, size, chunk);
+        if (rc != BDM_RC_OK)
+        {
+            break;
+        }
+
+        for (int i=0; i<size; i++)
+        {
+            if (chunk[i] != data_ptr[i])
+            {
+                *is_match      = false;
+                *mismatch_addr = (uint16_t)(addr+i);
+                return BDM_RC_OK;
+            }
+        }
+
+        addr     += size;
+        data_ptr += size;
+        count    -= size;
+    }
+
+    return rc;
+}
+
+//! Check a target memory range against a repeating pattern
+//!
+//! @param addr         : address of the first byte
+//! @param length       : number of bytes (addr+length must not exceed 0x10000)
+//! @param pattern      : pattern, repeated from addr
+//! @param pattern_size : size of the pattern (1 for a single byte, e.g. 0xFF for blank check)
+//! @param is_match     : true if the whole range matches
+//! @param fail_addr    : address of the first byte that doesn't match
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _check_halted() and bdm_cmd_read_block()
+//!
+uint8_t target_mem_check_pattern(uint16_t addr, uint32_t length, const uint8_t *pattern, uint8_t pattern_size, bool *is_match, uint16_t *fail_addr)
+{
+    uint8_t chunk[TARGET_MEM_CHUNK];
+    uint    phase = 0;
+    uint8_t rc = _check_halted();
+
+    *is_match = true;
+
+    while ((length > 0) && (rc == BDM_RC_OK))
+    {
+        uint8_t count = (length > TARGET_MEM_CHUNK) ? TARGET_MEM_CHUNK : (uint8_t)length;
+
+        rc = bdm_cmd_read_block(addr, count, chunk);
+        if (rc != BDM_RC_OK)
+        {
+            break;
+        }
+
+        for (int i=0; i<count; i++)
+        {
+            if (chunk[i] != pattern[phase])
+            {
+                *is_match  = false;
+                *fail_addr = (uint16_t)(addr+i);
+                return BDM_RC_OK;
+            }
+
+            phase = (phase + 1) % pattern_size;
+        }
+
+        addr   += count;
+        length -= count;
+    }
+
+    return rc;
+}
+
+//! Fill a target memory range with a repeating pattern
+//!
+//! @param addr         : address of the first byte
+//! @param length       : number of bytes (addr+length must not exceed 0x10000)
+//! @param pattern      : pattern, repeated from addr
+//! @param pattern_size : size of the pattern (1 to TARGET_MEM_MAX_PATTERN)
+//! @param verify       : read the range back
+//! @param is_ok        : true if the range has been filled (and verified)
+//! @param fail_addr    : address of the first byte that doesn't hold the pattern
+//!
+//! @return
+//!    == \ref BDM_RC_OK => success       \n
+//!    != \ref BDM_RC_OK => error, see _check_halted() and bdm_cmd_write_block()
+//!
+//! @note
+//!     Memory is written with WRITE_NEXT, TARGET_MEM_CHUNK bytes per burst.
+//!
+uint8_t target_mem_fill(uint16_t addr, uint32_t length, const uint8_t *pattern, uint8_t pattern_size, bool verify, bool *is_ok, uint16_t *fail_addr)
+{
+    uint8_t  chunk[TARGET_MEM_CHUNK];
+    uint16_t start = addr;
+    uint32_t remaining = length;
+    uint8_t  rc = _check_halted();
+
+    *is_ok = true;
+
+    // Every chunk starts at the beginning of the pattern
+    uint8_t chunk_size = TARGET_MEM_CHUNK - (TARGET_MEM_CHUNK % pattern_size);
+
+    for (int i=0; i<chunk_size; i++)
+    {
+        chunk[i] = pattern[i % pattern_size];
+    }
+
+    while ((remaining > 0) && (rc == BDM_RC_OK))
+    {
+        uint8_t count = (remaining > chunk_size) ? chunk_size : (uint8_t)remaining;
+
+        rc = bdm_cmd_write_block(addr, count, chunk);
+
+        addr      += count;
+        remaining -= count;
+    }
+
+    if ((rc == BDM_RC_OK) && verify)
+    {
+        return target_mem_check_pattern(start, length, pattern, pattern_size, is_ok, fail_addr);
+    }
+
+    return rc;
+}
@@ -0,0 +1,20 @@
+#ifndef TARGET_MEM_H_
+#define TARGET_MEM_H_
+
+#include "pico/stdlib.h"
+
+//--------------------------------------------------------------------+
+// TARGET MEMORY RANGE OPERATIONS
+//--------------------------------------------------------------------+
+// Operations over target memory ranges executed on the probe.
+// Memory is streamed with READ_NEXT, so the target must be halted.
+//
+#define TARGET_MEM_CHUNK    (MAX_BDM_FRAMES-2)  // Bytes streamed per burst (see bdm_cmd_read_block)
+#define TARGET_MEM_MAX_PATTERN  16              // Max size of a fill pattern
+
+uint8_t target_mem_crc32(uint16_t addr, uint32_t length, uint32_t *crc);
+uint8_t target_mem_verify(uint16_t addr, uint32_t count, const uint8_t *data_ptr, bool *is_match, uint16_t *mismatch_addr);
+uint8_t target_mem_fill(uint16_t addr, uint32_t length, const uint8_t *pattern, uint8_t pattern_size, bool verify, bool *is_ok, uint16_t *fail_addr);
+uint8_t target_mem_check_pattern(uint16_t addr, uint32_t length, const uint8_t *pattern, uint8_t pattern_size, bool *is_match, uint16_t *fail_addr);
+
+#endif /* TARGET_MEM_H_ */
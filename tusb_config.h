@@ -99,7 +99,7 @@
 #define CFG_TUD_CDC               0
 #define CFG_TUD_MSC               0
 #define CFG_TUD_MIDI              0
-#define CFG_TUD_VENDOR            1
+#define CFG_TUD_VENDOR            2  // Command interface + event interface
 
 #define CFG_TUD_VENDOR_RX_BUFSIZE  (256)
 #define CFG_TUD_VENDOR_TX_BUFSIZE  (256)
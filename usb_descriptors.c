@@ -47,6 +47,7 @@ uint8_t const desc_configuration[] =
 
 // Interface number, string index, EP Out & IN address, EP size
   TUD_VENDOR_DESCRIPTOR(BULK_INTF_ID, s_bulk_interface_index, USB_DIR_OUT | BULK_ENDPOINT, USB_DIR_IN | 2, CFG_TUD_VENDOR_EPSIZE),
+  TUD_VENDOR_DESCRIPTOR(EVENT_INTF_ID, s_event_interface_index, USB_DIR_OUT | EVENT_ENDPOINT, USB_DIR_IN | EVENT_ENDPOINT, CFG_TUD_VENDOR_EPSIZE),
 
   
 };
@@ -71,7 +72,8 @@ char const* string_desc_arr[] = {
       SERIAL_NO,
       CONFIGURATION_DESCRIPTION,
 
-      BULK_INTERFACE_DESCRIPTION
+      BULK_INTERFACE_DESCRIPTION,
+      EVENT_INTERFACE_DESCRIPTION
 };
 
 static uint16_t _desc_str[32];
@@ -44,6 +44,7 @@ static const uint8_t OS_StringDescriptor[] = {18, 3, 'M',0,'S',0,'F',0,'T',0,'1'
 
 enum InterfaceNumbers {
    BULK_INTF_ID,
+   EVENT_INTF_ID,
    //ITF_NUM_CDC_0,
    //ITF_NUM_CDC_0_DATA,
    
@@ -64,6 +65,9 @@ enum EndpointNumbers {
 
    /** Bulk endpoint number */
    BULK_ENDPOINT,
+
+   /** Event endpoint number (unsolicited target events) */
+   EVENT_ENDPOINT = 3,
    
    // CDC 0 Notif endpoint number
    //CDC_0_NOTIF_ENDPOINT,
@@ -89,7 +93,7 @@ enum Configurations {
 };
 
 
-#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_VENDOR_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN)
+#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + CFG_TUD_VENDOR * TUD_VENDOR_DESC_LEN + CFG_TUD_CDC * TUD_CDC_DESC_LEN)
 
 
 //--------------------------------------------------------------------+
@@ -110,6 +114,9 @@ enum StringIds {
    /** Name of Bulk interface */
    s_bulk_interface_index,
 
+   /** Name of Event interface */
+   s_event_interface_index,
+
    /** Name of CDC interface */
    s_cdc_interface_index,
 
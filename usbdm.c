@@ -10,17 +10,68 @@
 
 #include "cmd_proc.h"
 #include "config.h"
+#include "bdm.h"
+#include "pio_functions.h"
+#include "spsc_ring.h"
+#include "event.h"
 
+// Vendor class instance of the event interface (see usb_descriptors.c)
+#define EVENT_ITF   (1)
 
-static uint8_t command_buffer[MAX_COMMAND_SIZE];
-static uint8_t command_size = 0;
-static uint8_t offset = 0;
-static uint8_t saved_byte = 0;
+
+static uint16_t command_size = 0;
+// Bytes of the command received so far, [0] included
+static uint16_t offset = 0;
+// Bytes of the command read from the OUT endpoint FIFO, framing included
+static uint16_t stream_offset = 0;
 
 // Signal the presence of first pkt
 static bool first_pkt_received = false;
-
-
+// The command being received uses the extended framing
+static bool is_extended = false;
+// Bytes of a rejected command still to be dropped from the OUT endpoint FIFO
+static uint32_t discard_size = 0;
+
+//! Work handed from core 0 (USB) to core 1 (BDM)
+typedef enum {
+  JOB_COMMAND,    //!< Execute the USB command in buffer
+  JOB_CONNECT,    //!< Hold BKGD low while the target is power cycled, then SYNC
+  JOB_ERROR,      //!< Answer a rejected command, the response is already in buffer
+} usbdm_job_type_t;
+
+typedef struct {
+  usbdm_job_type_t type;
+  uint16_t         command_size;
+  uint16_t         response_size;                 //!< Set by core 1
+  uint16_t         response_offset;               //!< Bytes of the response already sent
+  uint8_t          buffer[MAX_EXT_COMMAND_SIZE];  //!< Command, then response
+} usbdm_job_t;
+
+// Command slots: the next command is received while the previous one is executed
+static usbdm_job_t jobs[USBDM_COMMAND_SLOTS];
+// Slot being assembled from USB (core 0 only)
+static uint8_t fill_slot = 0;
+// Jobs queued and not answered yet (core 0 only)
+static uint8_t jobs_in_flight = 0;
+// Executed job whose response hasn't fitted the IN endpoint yet (core 0 only)
+static usbdm_job_t *done_job = NULL;
+
+// Slots of the job rings (power of 2, at least USBDM_COMMAND_SLOTS)
+#define JOB_RING_SIZE (4)
+
+// Jobs from core 0 to core 1
+static void * volatile job_slots[JOB_RING_SIZE];
+static spsc_ring_t job_ring = SPSC_RING_INIT(job_slots);
+// Executed jobs from core 1 to core 0
+static void * volatile done_slots[JOB_RING_SIZE];
+static spsc_ring_t done_ring = SPSC_RING_INIT(done_slots);
+
+// Core 1 is waiting for jobs in RAM
+static volatile bool is_core1_idle = false;
+
+
+
+static void _queue_job(void);
 
 //--------------------------------------------------------------------+
 // USB UTILS
@@ -29,9 +80,10 @@ static bool first_pkt_received = false;
 /**
  *  Set a command response over EP1 IN
  * 
- *  @param total_bytes   = # of bytes to send
- *  @param byte_count = ptr to bytes to send
+ *  @param buffer     = ptr to bytes to send
+ *  @param byte_count = # of bytes to send
  *  
+ *  @return # of bytes queued (limited by the room in the IN endpoint FIFO)
  *
  *  @note : Returns before the command has been sent.
  *
@@ -39,12 +91,21 @@ static bool first_pkt_received = false;
  *      - [0]    = response
  *      - [1..N] = parameters
  */
-void send_USB_response(uint8_t *buffer, uint8_t byte_count)
+uint16_t send_USB_response(uint8_t *buffer, uint16_t byte_count)
 {
-  if (tud_vendor_write_available())
+  uint32_t available = tud_vendor_write_available();
+
+  if (byte_count > available)
+  {
+    byte_count = (uint16_t)available;
+  }
+
+  if (byte_count > 0)
   {
     tud_vendor_write(buffer, byte_count);
   }
+
+  return byte_count;
 }
 
 
@@ -81,73 +142,319 @@ void send_USB_response(uint8_t *buffer, uint8_t byte_count)
  *   | //// DATA ////////////// |
  *   |                          |
  *   +--------------------------+
+ *
+ *   ======================================================= 
+ *   Extended format (see CMD_USBDM_GET_CAPABILITIES) - a command
+ *   is made up of any number of pkts, up to MAX_EXT_COMMAND_SIZE
+ *
+ *    1st pkt
+ *   +--------------------------+
+ *   |  USBDM_EXT_FRAME (0xFF)  |  0 - Not a valid size in the format above
+ *   +--------------------------+
+ *   |  Size of entire command  |  1..2 - 16-bit, big endian, counted as above
+ *   +--------------------------+
+ *   |  Command byte            |  3
+ *   +--------------------------+
+ *   |                          |  4... up to BDM_OUT_EP_MAXSIZE-4
+ *   | //// DATA ////////////// |
+ *   |                          |
+ *   +--------------------------+
+ *    Following pkts
+ *   +--------------------------+
+ *   |                          |  0... up to BDM_OUT_EP_MAXSIZE-1
+ *   | //// DATA ////////////// |
+ *   |                          |
+ *   +--------------------------+
+ *
+ *   The command is stored as in the format above, with [0] = USBDM_EXT_FRAME
+ *   when the size doesn't fit a byte.
+ *
+ *   The OUT endpoint FIFO is read as a stream straight into the command slot:
+ *   framing bytes (extended header, 2nd pkt leading 0) are dropped while reading,
+ *   so data never goes through an intermediate buffer.
+ *
+ *   A command whose size is out of range is answered with BDM_RC_ILLEGAL_PARAMS.
+ *   The rest of it (the size it claims, or the rest of the FIFO when the size is
+ *   below 2) is dropped, so it can't be taken for the next command.
 */
 
 USBDM_ErrorCode receive_USB_command(void)
 {
-  uint8_t temp_buffer[BDM_IN_EP_MAXSIZE];
+  uint8_t *command_buffer = jobs[fill_slot].buffer;
 
-  uint8_t byte_count = tud_vendor_read(temp_buffer, BDM_IN_EP_MAXSIZE);
+  // The OUT endpoint FIFO is read as a stream, straight into the command slot
+  while (tud_vendor_available() > 0)
+  {
+    if (discard_size > 0)
+    {
+      uint8_t discard[16];
 
-  // Get first byte
-  uint8_t first_byte = temp_buffer[0];
+      discard_size -= tud_vendor_read(discard, (discard_size < sizeof(discard)) ? discard_size : sizeof(discard));
+      continue;
+    }
 
-  // 1st pkt or additional data
-  if (first_byte!=0)
-  {
     if (!first_pkt_received)
     {
-      // Save entire command size
-      command_size = first_byte;
+      // Get first byte
+      tud_vendor_read(command_buffer, 1);
+      stream_offset = 1;
+
+      if (command_buffer[0] == USBDM_EXT_FRAME)
+      {
+        // Extended format: 16-bit size follows (the whole pkt is in the FIFO)
+        uint8_t size_bytes[2];
+
+        tud_vendor_read(size_bytes, 2);
+        stream_offset += 2;
+
+        command_size = (uint16_t)((size_bytes[0]<<8) | size_bytes[1]);
+
+        command_buffer[0] = (command_size > MAX_COMMAND_SIZE) ? USBDM_EXT_FRAME : (uint8_t)command_size;
+        is_extended = true;
+      }
+      else
+      {
+        // Save entire command size
+        command_size = command_buffer[0];
+        is_extended = false;
+      }
+
+      if ((command_size < 2) || (command_size > (is_extended ? MAX_EXT_COMMAND_SIZE : MAX_COMMAND_SIZE)))
+      {
+        // Drop the rest of the command, without a valid size drop what has been received
+        discard_size = (command_size < 2) ? tud_vendor_available() : command_size - 1u;
+
+        send_USB_error_response(BDM_RC_ILLEGAL_PARAMS, 1);
+
+        // The next command waits for a free slot
+        break;
+      }
+
+      offset = 1;
+      first_pkt_received = true;
+    }
+    else if (!is_extended && (stream_offset == BDM_OUT_EP_MAXSIZE))
+    {
+      // Drop the leading 0 of the 2nd pkt
+      uint8_t marker;
 
-      // Save last byte of the first pkt
-      saved_byte = command_buffer[byte_count-1];
+      tud_vendor_read(&marker, 1);
+      stream_offset++;
+    }
+    else
+    {
+      uint32_t byte_count = command_size - offset;
 
-      first_pkt_received = true;
+      // The 1st pkt ends at BDM_OUT_EP_MAXSIZE
+      if (!is_extended && (stream_offset < BDM_OUT_EP_MAXSIZE) && (byte_count > BDM_OUT_EP_MAXSIZE - stream_offset))
+      {
+        byte_count = BDM_OUT_EP_MAXSIZE - stream_offset;
+      }
+
+      // Save data in command buffer, at its final place
+      byte_count = tud_vendor_read(command_buffer + offset, byte_count);
+
+      offset        += byte_count;
+      stream_offset += byte_count;
+    }
+
+    // All data has been received
+    if (first_pkt_received && (offset == command_size))
+    { 
+      // Hand the command to core 1. The response is sent by usbdm_response_task()
+      jobs[fill_slot].type = JOB_COMMAND;
+      jobs[fill_slot].command_size = command_size;
+      _queue_job();
+
+      // Reset
+      first_pkt_received = false;
+      offset = 0;
+
+      // The next command waits for a free slot
+      break;
     }
+  }
+
+  return BDM_RC_BUSY;
+}
+
+//--------------------------------------------------------------------+
+// BDM CORE
+//--------------------------------------------------------------------+
+
+// Hand the filled slot to core 1 and move to the next one
+static void _queue_job(void)
+{
+  jobs_in_flight++;
+
+  // Jobs in flight never exceed the slots, so the ring can't be full
+  spsc_ring_push(&job_ring, &jobs[fill_slot]);
+
+  // Slots are executed and answered in order
+  fill_slot = (fill_slot + 1) % USBDM_COMMAND_SLOTS;
+}
+
+//! Queue a connection sequence on core 1 (board button)
+void usbdm_queue_connect(void)
+{
+  // The slot is in use by a command being received
+  if (first_pkt_received)
+  {
+    return;
+  }
+
+  jobs[fill_slot].type = JOB_CONNECT;
+  _queue_job();
+}
 
-    if (command_size > MAX_COMMAND_SIZE) 
+//! All slots are queued or running, a new job can't be accepted
+bool usbdm_is_busy(void)
+{
+  return jobs_in_flight == USBDM_COMMAND_SLOTS;
+}
+
+//! Core 1 is idle and running from RAM, so core 0 can temporarily disable flash access (e.g. to read BOOTSEL)
+bool usbdm_is_core1_idle(void)
+{
+  return jobs_in_flight == 0 && is_core1_idle;
+}
+
+//! Send the response of the oldest executed job
+//!
+//! @param status = status of the executed command
+//!
+//! @return true if a job has completed
+//!
+//! @note
+//!   A response is streamed as room is made in the IN endpoint FIFO, meanwhile
+//!   core 1 goes on with the next slot
+//!
+bool usbdm_response_task(USBDM_ErrorCode *status)
+{
+  if (done_job == NULL)
+  {
+    if (!spsc_ring_pop(&done_ring, (void**)&done_job))
     {
-      command_size = MAX_COMMAND_SIZE;
+      return false;
     }
+    done_job->response_offset = 0;
+  }
+
+  if (done_job->type != JOB_CONNECT)
+  {
+    done_job->response_offset += send_USB_response(done_job->buffer + done_job->response_offset,
+                                                   done_job->response_size - done_job->response_offset);
 
-    // Save data in command buffer
-    memcpy(command_buffer + offset, temp_buffer, byte_count);
+    if (done_job->response_offset < done_job->response_size)
+    {
+      return false;
+    }
+    *status = done_job->buffer[0];
   }
-  //2nd packet
   else
   {
-    // Save data in command buffer
-    memcpy(command_buffer + (offset-1), temp_buffer, byte_count);
+    *status = BDM_RC_OK;
+  }
 
-    // Overwrite the first byte of the second packet, which contains zero, with the last byte of the first packet previously saved.
-    command_buffer[offset-1] = saved_byte;
+  done_job = NULL;
+  jobs_in_flight--;
 
-    // Do not consider the first 0x00 byte in 2nd pkt in data count
-    byte_count--;
+  return true;
+}
+
+// Execute a job (core 1)
+static void _job_exec(usbdm_job_t *exec_job)
+{
+  switch (exec_job->type)
+  {
+    case JOB_COMMAND:
+    {
+      // NOTE: after excecuting a command, command_exec return the number of bytes to send back to host;
+      exec_job->response_size = command_exec(exec_job->buffer, exec_job->command_size);
+      break;
+    }
+    case JOB_CONNECT:
+    {
+      // Hold BKGD pin low for 5 seconds
+      bdm_connect();
+
+      // SYNC (or guess the speed), as CMD_USBDM_CONNECT
+      _cmd_usbdm_connect();
+      break;
+    }
+    case JOB_ERROR:
+    {
+      // Reported by CMD_USBDM_GET_COMMAND_STATUS as well
+      set_command_status(exec_job->buffer[0]);
+      break;
+    }
   }
+}
 
-  offset += byte_count;
+//! Send the events produced by core 1 on the event interface
+//!
+//! @note
+//!   The FIFO is a byte stream, records written back to back would be packed across packets.
+//!   A record is only written once the previous one has left the IN endpoint FIFO, and is
+//!   flushed right away, so every packet carries exactly one record.\n
+//!   Anything sent by the host on the event interface is discarded.
+//!
+void usbdm_event_task(void)
+{
+  event_t *event;
 
-  // All data has been received
-  if(offset == command_size)
-  { 
-    // Execute the command
-    // NOTE: after excecuting a command, command_exec return the number of bytes to send back to host;
-    uint8_t return_size = command_exec(command_buffer);
+  while ((event = event_peek()) != NULL)
+  {
+    if (tud_vendor_n_write_available(EVENT_ITF) < CFG_TUD_VENDOR_TX_BUFSIZE)
+    {
+      break;
+    }
 
-    send_USB_response(command_buffer, return_size);
+    tud_vendor_n_write(EVENT_ITF, event, 2 + event->size);
+    tud_vendor_n_write_flush(EVENT_ITF);
+    event_release();
+  }
 
-    // Reset
-    first_pkt_received = false;
-    offset = 0;
+  while (tud_vendor_n_available(EVENT_ITF) > 0)
+  {
+    uint8_t discard[16];
 
-    // Return command status
-    return command_buffer[0];
+    tud_vendor_n_read(EVENT_ITF, discard, sizeof(discard));
   }
-  else
+}
+
+//! Core 1 main loop: executes the BDM side of every job, while core 0 keeps servicing USB
+//!
+//! @note
+//!   The wait loop runs from RAM, see \ref usbdm_is_core1_idle.\n
+//!   Background work (see \ref command_background_task) runs from flash, so core 1
+//!   is not idle meanwhile. It is only armed by a job, which keeps core 0 from
+//!   seeing core 1 idle while it starts.
+//!
+void __not_in_flash_func(usbdm_core1_main)(void)
+{
+  while (1)
   {
-    return BDM_RC_BUSY;
+    usbdm_job_t *next_job;
+
+    while (!spsc_ring_pop(&job_ring, (void**)&next_job))
+    {
+      if (is_background_active)
+      {
+        is_core1_idle = false;
+        command_background_task();
+      }
+      else
+      {
+        is_core1_idle = true;
+      }
+    }
+    is_core1_idle = false;
+
+    _job_exec(next_job);
+
+    // Jobs in flight never exceed the slots, so the ring can't be full
+    spsc_ring_push(&done_ring, next_job);
   }
 }
 
@@ -184,13 +491,25 @@ bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_requ
 }
 
 
+//! Answer the command being received with an error
+//!
+//! @param code = error code
+//! @param size = size of the response (the error code is [0])
+//!
+//! @return code
+//!
+//! @note
+//!   The response is queued as a job, so it is sent after the responses of the commands
+//!   received before. The slot must be free (see \ref usbdm_is_busy).
+//!
 USBDM_ErrorCode send_USB_error_response(USBDM_ErrorCode code, uint8_t size)
 {
-  // Error
-  command_buffer[0] = code;
-  set_command_status(code);
+  usbdm_job_t *job = &jobs[fill_slot];
 
-  send_USB_response(command_buffer, size);
+  job->type          = JOB_ERROR;
+  job->buffer[0]     = code;
+  job->response_size = size;
+  _queue_job();
 
   return code;
 }
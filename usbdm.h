@@ -55,9 +55,33 @@ typedef enum {
    CMD_USBDM_READ_DREG             = 31,  //!< Read from target Debug register
 
    CMD_USBDM_WRITE_MEM             = 32,  //!< Write to target memory
-   CMD_USBDM_READ_MEM              = 33  //!< Read from target memory
+   CMD_USBDM_READ_MEM              = 33, //!< Read from target memory
+
+   // Probe specific commands
+   CMD_USBDM_STUB_SETUP            = 64, //!< Set up a programming stub downloaded in target RAM
+   CMD_USBDM_STUB_PROGRAM          = 65, //!< Program a page with the stub (returns while the page is programmed)
+   CMD_USBDM_STUB_WAIT             = 66, //!< Wait for the stub to complete @return [1] stub result code
+   CMD_USBDM_FLASH_SETUP           = 67, //!< Set up the HCS08 flash module (FCDIV)
+   CMD_USBDM_FLASH_ERASE           = 68, //!< Erase or blank check HCS08 flash
+   CMD_USBDM_FLASH_PROGRAM         = 69, //!< Program a block of HCS08 flash
+   CMD_USBDM_CACHE_CONFIG          = 70, //!< Configure the target memory cache
+   CMD_USBDM_READ_ALL_REGS         = 71, //!< Read A, CCR, PC, HX and SP @return [1..8] registers
+   CMD_USBDM_EXEC_SCRIPT           = 72, //!< Execute a BDM script on the probe @return [1..N] script results
+   CMD_USBDM_CRC32_MEM             = 73, //!< CRC32 of a target memory range @return [1..4] CRC32
+   CMD_USBDM_VERIFY_MEM            = 74, //!< Compare target memory against data @return [1] mismatch, [2..3] first mismatch address
+   CMD_USBDM_FILL_MEM              = 75, //!< Fill target memory with a pattern @return [1] failed, [2..3] first failing address
+   CMD_USBDM_BLANK_CHECK_MEM       = 76, //!< Check target memory is blank (0xFF) @return [1] not blank, [2..3] first failing address
+   CMD_USBDM_WRITE_MEM_EXT         = 77, //!< Write a large block to target memory (extended framing)
+   CMD_USBDM_READ_MEM_EXT          = 78, //!< Read a large block from target memory (extended framing)
+   CMD_USBDM_HALT_EVENT            = 79, //!< Configure the halt event sent on the event interface after GO
+   CMD_USBDM_LIVE_WATCH            = 80, //!< Stream samples of target memory on the event interface while the target runs
+   CMD_USBDM_TRACE                 = 81, //!< Step N instructions on the probe and return the trace
+   CMD_USBDM_RUN_UNTIL             = 82, //!< Run/step the target until a condition evaluated on the probe is met
 } BDMCommands;
 
+//! First byte of a command using the extended framing (see receive_USB_command)
+#define USBDM_EXT_FRAME   (0xFF)
+
 //==========================================================================================
 // Error code
 
@@ -200,5 +224,11 @@ typedef enum  {
 
 
 USBDM_ErrorCode receive_USB_command(void);
-void send_USB_response(uint8_t *buffer, uint8_t byte_count);
+bool usbdm_response_task(USBDM_ErrorCode *status);
+void usbdm_queue_connect(void);
+bool usbdm_is_busy(void);
+bool usbdm_is_core1_idle(void);
+void usbdm_core1_main(void);
+void usbdm_event_task(void);
+uint16_t send_USB_response(uint8_t *buffer, uint16_t byte_count);
 USBDM_ErrorCode send_USB_error_response(USBDM_ErrorCode code, uint8_t size);
\ No newline at end of file